@@ -0,0 +1,8 @@
+#!/bin/bash
+
+# collective suite across rank counts, one rank per host:
+HOSTS=10.1.100.40,10.1.100.42,10.1.100.44,10.1.100.46,10.1.100.48,10.1.100.50,10.1.100.52,10.1.100.54
+
+for NP in 2 3 4 5 6 7 8; do
+	mpirun -mca btl_openib_receive_queues P,65536,256,192,128:S,128,256,192,128:S,2048,1024,1008,64:S,12288,1024,1008,64:S,65536,1024,1008,64 -np $NP -H $HOSTS collectives
+done
@@ -0,0 +1,229 @@
+#include <iostream>
+#include <chrono>
+#include <mpi.h>
+#include <assert.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include "rotor_coll.h"
+
+// Collective suite: each MPI collective vs its rotor_coll version, which
+// runs on the rotor shift schedule (in slot s, rank r sends to r + s and
+// receives from r - s, as in rlb_v1).
+
+const int NUM_ITERS = 20; // timed iterations per collective and size
+const int WARMUP_ITERS = 2; // untimed iterations before each measurement
+
+// ints per block (per rank for allgather/alltoall/reduce_scatter, total for bcast/allreduce):
+const int ITEM_COUNTS[] = { 1, 16, 256, 4096, 65536, 262144 }; // 4 B to 1 MB
+
+// rotor_coll pipelining chunk sizes to compare against the library:
+const int CHUNK_BYTES[] = { 0, 16384, 65536, 262144 }; // 0 = one message per slot
+
+enum Collective { ALLGATHER, BCAST, ALLTOALL, ALLTOALLV, REDUCE_SCATTER, ALLREDUCE };
+const char * COLLECTIVE_NAMES[] = { "allgather", "bcast", "alltoall", "alltoallv", "reduce_scatter", "allreduce" };
+
+void collective_suite(int size, int rank);
+
+using namespace std;
+using namespace chrono;
+
+int main(int argc, char* argv[])
+{
+	int size, rank;
+
+	assert(steady_clock::is_steady);
+
+	MPI_Init(&argc, &argv);
+
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	collective_suite(size, rank);
+
+	MPI_Finalize();
+
+	return 0;
+}
+
+/* Benchmark driver */
+
+// run one collective; native selects the MPI library implementation
+void run_collective(Collective coll, bool native, int count, int size, int rank,
+	int * sendbuf, int * recvbuf) {
+
+	// alltoallv sends count or 2 * count ints from rank i to rank j depending on i + j:
+	vector<int> sendcounts(size), recvcounts(size), sdispls(size), rdispls(size);
+	if (coll == ALLTOALLV) {
+		for (int j = 0; j < size; j++) {
+			sendcounts[j] = count * (1 + (rank + j) % 2);
+			recvcounts[j] = sendcounts[j];
+			sdispls[j] = j == 0 ? 0 : sdispls[j - 1] + sendcounts[j - 1];
+			rdispls[j] = j == 0 ? 0 : rdispls[j - 1] + recvcounts[j - 1];
+		}
+	}
+	vector<int> blockcounts(size, count);
+
+	switch (coll) {
+		case ALLGATHER:
+			if (native)
+				MPI_Allgather(sendbuf, count, MPI_INT, recvbuf, count, MPI_INT, MPI_COMM_WORLD);
+			else
+				rotor_allgather(sendbuf, count, MPI_INT, recvbuf, count, MPI_INT, MPI_COMM_WORLD);
+			break;
+		case BCAST:
+			if (rank == 0)
+				memcpy(recvbuf, sendbuf, count * sizeof(int));
+			if (native)
+				MPI_Bcast(recvbuf, count, MPI_INT, /* root */ 0, MPI_COMM_WORLD);
+			else
+				rotor_bcast(recvbuf, count, MPI_INT, /* root */ 0, MPI_COMM_WORLD);
+			break;
+		case ALLTOALL:
+			if (native)
+				MPI_Alltoall(sendbuf, count, MPI_INT, recvbuf, count, MPI_INT, MPI_COMM_WORLD);
+			else
+				rotor_alltoall(sendbuf, count, MPI_INT, recvbuf, count, MPI_INT, MPI_COMM_WORLD);
+			break;
+		case ALLTOALLV:
+			if (native)
+				MPI_Alltoallv(sendbuf, sendcounts.data(), sdispls.data(), MPI_INT,
+					recvbuf, recvcounts.data(), rdispls.data(), MPI_INT, MPI_COMM_WORLD);
+			else
+				rotor_alltoallv(sendbuf, sendcounts.data(), sdispls.data(), MPI_INT,
+					recvbuf, recvcounts.data(), rdispls.data(), MPI_INT, MPI_COMM_WORLD);
+			break;
+		case REDUCE_SCATTER:
+			if (native)
+				MPI_Reduce_scatter(sendbuf, recvbuf, blockcounts.data(), MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+			else
+				rotor_reduce_scatter(sendbuf, recvbuf, blockcounts.data(), MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+			break;
+		case ALLREDUCE:
+			if (native)
+				MPI_Allreduce(sendbuf, recvbuf, count, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+			else
+				rotor_allreduce(sendbuf, recvbuf, count, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+			break;
+	}
+}
+
+// ints of output produced on each rank
+int result_count(Collective coll, int count, int size) {
+	switch (coll) {
+		case ALLGATHER:
+		case ALLTOALL:
+			return count * size;
+		case ALLTOALLV:
+			return count * size * 2; // upper bound, only the received part is compared
+		default:
+			return count;
+	}
+}
+
+// time NUM_ITERS runs; each sample is the slowest rank's time for that iteration
+vector<double> time_collective(Collective coll, bool native, int count, int size, int rank,
+	int * sendbuf, int * recvbuf) {
+
+	vector<double> times(NUM_ITERS);
+
+	for (int i = 0; i < WARMUP_ITERS + NUM_ITERS; i++) {
+		MPI_Barrier(MPI_COMM_WORLD);
+		auto begin = steady_clock::now();
+		run_collective(coll, native, count, size, rank, sendbuf, recvbuf);
+		auto end = steady_clock::now();
+
+		double elapsed = duration<double, micro>(end - begin).count();
+		double slowest = 0;
+		MPI_Reduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+		if (i >= WARMUP_ITERS)
+			times[i - WARMUP_ITERS] = slowest;
+	}
+
+	sort(times.begin(), times.end());
+	return times;
+}
+
+void collective_suite(int size, int rank) {
+
+	int Nsizes = sizeof(ITEM_COUNTS) / sizeof(ITEM_COUNTS[0]);
+	int maxints = *max_element(ITEM_COUNTS, ITEM_COUNTS + Nsizes);
+	int Nchunks = sizeof(CHUNK_BYTES) / sizeof(CHUNK_BYTES[0]);
+
+	// large enough for the biggest alltoallv:
+	size_t bufints = (size_t)maxints * size * 2;
+	int * sendbuf = new int[bufints];
+	int * recvbuf = new int[bufints];
+	int * checkbuf = new int[bufints];
+	for (size_t i = 0; i < bufints; i++)
+		sendbuf[i] = rank * 1000 + (int)(i % 1000);
+
+	if (rank == 0) {
+		cout << "Collective times in microseconds (slowest rank per iteration), N=" << size << ":" << endl;
+		cout << "collective bytes native_min native_median native_mean";
+		for (int k = 0; k < Nchunks; k++)
+			cout << " rotor_median@" << CHUNK_BYTES[k];
+		cout << " best_chunk rotor_min rotor_median rotor_mean rotor_speedup check" << endl;
+	}
+
+	for (int c = ALLGATHER; c <= ALLREDUCE; c++) {
+		Collective coll = (Collective)c;
+
+		for (int s = 0; s < Nsizes; s++) {
+			int count = ITEM_COUNTS[s];
+			int outints = result_count(coll, count, size);
+
+			// the library's result, which the rotor version must reproduce at every chunk size:
+			memset(checkbuf, 0, outints * sizeof(int));
+			run_collective(coll, true, count, size, rank, sendbuf, checkbuf);
+			int local_ok = 1;
+
+			vector<double> native = time_collective(coll, true, count, size, rank, sendbuf, recvbuf);
+
+			// rotor version at each pipelining chunk size, keeping the best:
+			vector<double> rotor_medians(Nchunks);
+			vector<double> best;
+			int best_chunk = 0;
+			for (int k = 0; k < Nchunks; k++) {
+				rotor_coll_set_chunk_bytes(CHUNK_BYTES[k]);
+				memset(recvbuf, 0, outints * sizeof(int));
+				run_collective(coll, false, count, size, rank, sendbuf, recvbuf);
+				local_ok &= memcmp(checkbuf, recvbuf, outints * sizeof(int)) == 0;
+
+				vector<double> rotor = time_collective(coll, false, count, size, rank, sendbuf, recvbuf);
+				rotor_medians[k] = rotor[NUM_ITERS / 2];
+				if (best.empty() || rotor_medians[k] < best[NUM_ITERS / 2]) {
+					best = rotor;
+					best_chunk = CHUNK_BYTES[k];
+				}
+			}
+			int all_ok = 0;
+			MPI_Reduce(&local_ok, &all_ok, 1, MPI_INT, MPI_LAND, 0, MPI_COMM_WORLD);
+
+			if (rank == 0) {
+				double native_mean = 0, rotor_mean = 0;
+				for (int i = 0; i < NUM_ITERS; i++) {
+					native_mean += native[i] / NUM_ITERS;
+					rotor_mean += best[i] / NUM_ITERS;
+				}
+				double native_median = native[NUM_ITERS / 2];
+				double rotor_median = best[NUM_ITERS / 2];
+
+				cout << COLLECTIVE_NAMES[c] << " " << count * sizeof(int) << " "
+					<< native.front() << " " << native_median << " " << native_mean;
+				for (int k = 0; k < Nchunks; k++)
+					cout << " " << rotor_medians[k];
+				cout << " " << best_chunk << " "
+					<< best.front() << " " << rotor_median << " " << rotor_mean << " "
+					<< native_median / rotor_median << " " << (all_ok ? "ok" : "MISMATCH") << endl;
+			}
+		}
+	}
+
+	rotor_coll_set_chunk_bytes(ROTOR_COLL_CHUNK_BYTES);
+
+	delete [] sendbuf;
+	delete [] recvbuf;
+	delete [] checkbuf;
+}
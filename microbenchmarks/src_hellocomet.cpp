@@ -4,6 +4,8 @@
 #include <assert.h>
 #include <string.h>
 #include <vector>
+#include <algorithm>
+#include <random>
 
 const int NUM_ITERS = 100;
 const int WAIT = 1; // time to wait between sends in microseconds
@@ -21,8 +23,31 @@ const int ITEM_COUNT = 1;
 //const int ITEM_COUNT = 12500000; // 50 MB
 //const int ITEM_COUNT = 125000000; // 500 MB
 
+// latency under load: rank 0 probes rank 1 while ranks 2.. stream to rank 1
+const int LOAD_ITEM_COUNT = 262144; // background message size, 262144 ints = 1 MB
+const int LOAD_WINDOW = 4; // max outstanding background messages per rank
+const int64_t LOAD_US = 100000; // time spent at each offered load, microseconds
+const int PROBE_WAIT = 10; // time to wait between probes in microseconds
+const double LOAD_GBPS[] = { 0, 1, 2, 5, 10, 20, 40, 80 }; // aggregate offered load
+
+// receiver switching: NUM_ITERS visits per configuration, SWITCH_MSGS messages per visit
+const int SWITCH_MSGS = 4; // messages sent to a receiver each time it is selected
+const int SWITCH_SEED = 1; // seed for the random send order
+const int SWITCH_RECEIVERS[] = { 1, 2, 4, 8, 16 }; // skipped if more than size - 1
+const int SWITCH_ITEM_COUNTS[] = { 1, 1024, 16384, 262144 }; // 4 B to 1 MB
+const int SWITCH_WAITS[] = { 0, 1, 10, 100 }; // time to wait between sends in microseconds
+
+// compute/communication overlap: rank 0 sends to rank 1 while both run a compute kernel
+const int OVERLAP_ITERS = 20; // timed transfers per configuration, the median is reported
+const int OVERLAP_COMPUTE_US = 1000; // duration of the compute kernel in microseconds
+const int OVERLAP_ITEM_COUNTS[] = { 1, 1024, 16384, 262144, 1048576 }; // 4 B to 4 MB
+const int OVERLAP_TEST_US[] = { 0, 1000, 100, 10 }; // compute between MPI_Test calls, 0 = no MPI_Test
+
 void latency_test(int size, int rank);
+void latency_under_load_test(int size, int rank);
 void cycle_receiver_test(int size, int rank);
+void receiver_switch_test(int size, int rank);
+void overlap_test(int size, int rank);
 void delayed_message_stream_test(int size, int rank);
 void throughput_test(int size, int rank);
 void throughput_vect_test(int size, int rank);
@@ -50,7 +75,10 @@ int main(int argc, char* argv[])
 	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
 	//latency_test(size, rank); // ping pong latency between sender & receiver
+	//latency_under_load_test(size, rank); // ping pong latency vs background load
 	cycle_receiver_test(size, rank); // cycle through different receivers	
+	//receiver_switch_test(size, rank); // sweep receivers, sizes, gaps and send orders
+	//overlap_test(size, rank); // does MPI progress transfers while we compute?
 	//delayed_message_stream_test(size,rank); // send, wait, send, wait, ...
 	//throughput_vect_test(size, rank); // sweep over multiple message sizes
 	
@@ -94,6 +122,167 @@ void latency_test(int size, int rank) {
 	}
 }
 
+double percentile(const vector<double> &sorted, double p) {
+	// sorted must be in ascending order and non-empty
+	size_t idx = (size_t)(p * sorted.size());
+	if (idx >= sorted.size())
+		idx = sorted.size() - 1;
+	return sorted[idx];
+}
+
+void latency_under_load_test(int size, int rank) {
+
+	const int PROBE_TAG = 1;
+	const int STOP_TAG = 2;
+	const int LOAD_TAG = 3;
+
+	if (size < 3) {
+		if (rank == 0)
+			cout << "latency_under_load_test needs at least 3 ranks" << endl;
+		return;
+	}
+
+	int Nloaders = size - 2; // ranks 2.. generate background traffic
+	int Nlevels = sizeof(LOAD_GBPS) / sizeof(LOAD_GBPS[0]);
+	double load_bits = (double)LOAD_ITEM_COUNT * sizeof(int) * 8;
+
+	// background send/receive buffers:
+	vector<int *> bufs;
+	if (rank >= 1) {
+		bufs.resize(LOAD_WINDOW);
+		for (int w = 0; w < LOAD_WINDOW; w++) {
+			bufs[w] = new int[LOAD_ITEM_COUNT];
+			for (int i = 0; i < LOAD_ITEM_COUNT; i++)
+				bufs[w][i] = i;
+		}
+	}
+
+	if (rank == 0) {
+		cout << "Probe RTT in microseconds vs aggregate offered load (" << Nloaders
+			<< " loaders, " << LOAD_ITEM_COUNT * sizeof(int) << " B messages):" << endl;
+		cout << "offered_gbps achieved_gbps probes min median p90 p99 max" << endl;
+	}
+
+	for (int l = 0; l < Nlevels; l++) {
+
+		// every loader sends the same number of evenly paced messages:
+		double rate_gbps = LOAD_GBPS[l] / Nloaders;
+		double gap_us = rate_gbps > 0 ? load_bits / (rate_gbps * 1e3) : 0;
+		int Nmsgs = rate_gbps > 0 ? (int)(LOAD_US / gap_us) : 0;
+
+		MPI_Barrier(MPI_COMM_WORLD);
+		int64_t start = get_us();
+
+		if (rank == 0) { // probe sender
+
+			int value = 42;
+			vector<double> rtts;
+
+			while (get_us() - start < LOAD_US) {
+				auto begin = steady_clock::now();
+				MPI_Send(&value, 1, MPI_INT, /* dst */ 1, PROBE_TAG, MPI_COMM_WORLD);
+				MPI_Recv(&value, 1, MPI_INT, /* source */ 1,
+						 PROBE_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+				auto end = steady_clock::now();
+				rtts.push_back(duration<double, micro>(end - begin).count());
+
+				// poll over the wait period:
+				int64_t wait_start = get_us();
+				while ((get_us() - wait_start) < PROBE_WAIT) {}
+			}
+			MPI_Send(&value, 1, MPI_INT, /* dst */ 1, STOP_TAG, MPI_COMM_WORLD);
+
+			double achieved_gbps = 0;
+			MPI_Recv(&achieved_gbps, 1, MPI_DOUBLE, /* source */ 1,
+					 MPI_ANY_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+			sort(rtts.begin(), rtts.end());
+			cout << LOAD_GBPS[l] << " " << achieved_gbps << " " << rtts.size() << " "
+				<< rtts.front() << " " << percentile(rtts, 0.5) << " "
+				<< percentile(rtts, 0.9) << " " << percentile(rtts, 0.99) << " "
+				<< rtts.back() << endl;
+
+		} else if (rank == 1) { // probe responder & background sink
+
+			int expected = Nmsgs * Nloaders;
+			int load_posted = 0;
+			int load_received = 0;
+			int64_t last_load = start;
+			bool stopped = false;
+			int value = -1;
+
+			// request 0 is the probe, the rest are background receives:
+			vector<MPI_Request> r_handles(LOAD_WINDOW + 1, MPI_REQUEST_NULL);
+			MPI_Irecv(&value, 1, MPI_INT, /* source */ 0,
+				MPI_ANY_TAG, MPI_COMM_WORLD, &r_handles[0]);
+			for (int w = 0; w < LOAD_WINDOW && load_posted < expected; w++, load_posted++)
+				MPI_Irecv(bufs[w], LOAD_ITEM_COUNT, MPI_INT, MPI_ANY_SOURCE,
+					LOAD_TAG, MPI_COMM_WORLD, &r_handles[w + 1]);
+
+			while (!stopped || load_received < expected) {
+				int idx, done;
+				MPI_Status status;
+				MPI_Testany(LOAD_WINDOW + 1, r_handles.data(), &idx, &done, &status);
+				if (done == 0 || idx == MPI_UNDEFINED)
+					continue;
+
+				if (idx == 0) {
+					if (status.MPI_TAG == STOP_TAG) {
+						stopped = true;
+					} else {
+						MPI_Send(&value, 1, MPI_INT, /* dst */ 0, PROBE_TAG, MPI_COMM_WORLD);
+						MPI_Irecv(&value, 1, MPI_INT, /* source */ 0,
+							MPI_ANY_TAG, MPI_COMM_WORLD, &r_handles[0]);
+					}
+				} else {
+					load_received++;
+					last_load = get_us();
+					if (load_posted < expected) {
+						MPI_Irecv(bufs[idx - 1], LOAD_ITEM_COUNT, MPI_INT, MPI_ANY_SOURCE,
+							LOAD_TAG, MPI_COMM_WORLD, &r_handles[idx]);
+						load_posted++;
+					}
+				}
+			}
+
+			double achieved_gbps = 0;
+			if (last_load > start)
+				achieved_gbps = load_bits * load_received / ((last_load - start) * 1e3);
+			MPI_Send(&achieved_gbps, 1, MPI_DOUBLE, /* dst */ 0, 0, MPI_COMM_WORLD);
+
+		} else { // background load generator
+
+			vector<MPI_Request> s_handles(LOAD_WINDOW, MPI_REQUEST_NULL);
+			vector<int> indices(LOAD_WINDOW);
+			int posted = 0;
+
+			while (posted < Nmsgs) {
+				// keep the outstanding sends progressing:
+				int Ndone;
+				MPI_Testsome(LOAD_WINDOW, s_handles.data(), &Ndone, indices.data(), MPI_STATUSES_IGNORE);
+
+				// pace the sends to the offered load:
+				if (get_us() - start < (int64_t)(posted * gap_us))
+					continue;
+
+				for (int w = 0; w < LOAD_WINDOW; w++) {
+					if (s_handles[w] == MPI_REQUEST_NULL) {
+						MPI_Isend(bufs[w], LOAD_ITEM_COUNT, MPI_INT, /* dst */ 1,
+							LOAD_TAG, MPI_COMM_WORLD, &s_handles[w]);
+						posted++;
+						break;
+					}
+				}
+			}
+
+			MPI_Waitall(LOAD_WINDOW, s_handles.data(), MPI_STATUSES_IGNORE);
+		}
+	}
+
+	for (size_t w = 0; w < bufs.size(); w++)
+		delete [] bufs[w];
+}
+
 void cycle_receiver_test(int size, int rank) {
 
 	int numints = 262144; // set the message size
@@ -164,6 +353,306 @@ void cycle_receiver_test(int size, int rank) {
 
 }
 
+enum SendOrder { ORDER_ROUND_ROBIN, ORDER_RANDOM, ORDER_ROTOR };
+
+// receiver of rank 0 in each visit, or for ORDER_ROTOR the shift of the
+// matching every rank of the group 0..Nreceivers follows in that visit
+vector<int> switch_schedule(SendOrder order, int Nreceivers, int seed) {
+	vector<int> schedule(NUM_ITERS);
+	mt19937 gen(seed);
+	uniform_int_distribution<int> pick(1, Nreceivers);
+
+	for (int v = 0; v < NUM_ITERS; v++) {
+		switch (order) {
+			case ORDER_ROUND_ROBIN:
+				schedule[v] = 1 + v % Nreceivers;
+				break;
+			case ORDER_RANDOM:
+				// always switch to a different receiver if there is one:
+				do {
+					schedule[v] = pick(gen);
+				} while (Nreceivers > 1 && v > 0 && schedule[v] == schedule[v - 1]);
+				break;
+			case ORDER_ROTOR:
+				// shift-based matching over the group, as in rlb_v1:
+				schedule[v] = v % Nreceivers;
+				break;
+		}
+	}
+	return schedule;
+}
+
+void receiver_switch_test(int size, int rank) {
+
+	const char * order_names[] = { "round-robin", "random", "rotor" };
+	int Nsizes = sizeof(SWITCH_ITEM_COUNTS) / sizeof(SWITCH_ITEM_COUNTS[0]);
+	int Nwaits = sizeof(SWITCH_WAITS) / sizeof(SWITCH_WAITS[0]);
+	int Nrecv_opts = sizeof(SWITCH_RECEIVERS) / sizeof(SWITCH_RECEIVERS[0]);
+
+	int maxints = *max_element(SWITCH_ITEM_COUNTS, SWITCH_ITEM_COUNTS + Nsizes);
+	int * sendbuf = new int[maxints];
+	int * recvbuf = new int[maxints];
+	for (int i = 0; i < maxints; i++) {
+		sendbuf[i] = i;
+		recvbuf[i] = i;
+	}
+
+	if (rank == 0) {
+		cout << "Send + ACK times in microseconds, split into first contact (cold), "
+			<< "first message after switching peers (switch) and the rest (steady):" << endl;
+		cout << "order receivers bytes wait_us cold_n cold_median switch_n switch_median switch_p99"
+			<< " steady_n steady_median steady_p99 switch_penalty" << endl;
+	}
+
+	for (int o = ORDER_ROUND_ROBIN; o <= ORDER_ROTOR; o++) {
+	for (int r = 0; r < Nrecv_opts; r++) {
+	for (int s = 0; s < Nsizes; s++) {
+	for (int w = 0; w < Nwaits; w++) {
+
+		SendOrder order = (SendOrder)o;
+		int Nreceivers = SWITCH_RECEIVERS[r];
+		int numints = SWITCH_ITEM_COUNTS[s];
+		int wait_us = SWITCH_WAITS[w];
+		if (Nreceivers > size - 1)
+			continue;
+
+		vector<int> schedule = switch_schedule(order, Nreceivers, SWITCH_SEED + r);
+		vector<double> cold, switched, steady;
+
+		// a message is "cold" if it is the first one of this configuration to that peer:
+		vector<bool> contacted(size, false);
+		int prev_peer = -1;
+
+		MPI_Barrier(MPI_COMM_WORLD);
+
+		for (int v = 0; v < NUM_ITERS; v++) {
+			for (int m = 0; m < SWITCH_MSGS; m++) {
+
+				double elapsed = -1; // only set on timed sends
+				int peer = -1;
+
+				if (order == ORDER_ROTOR) {
+					if (rank > Nreceivers)
+						break;
+					// every rank r of the group sends to r + 1 + shift and
+					// receives from r - 1 - shift in each visit:
+					int group = Nreceivers + 1;
+					int dst = (rank + 1 + schedule[v]) % group;
+					int src = (rank - 1 - schedule[v] + group) % group;
+
+					MPI_Request handles[2];
+					auto begin = steady_clock::now();
+					MPI_Irecv(recvbuf, numints, MPI_INT, src, MPI_ANY_TAG,
+						MPI_COMM_WORLD, &handles[0]);
+					MPI_Isend(sendbuf, numints, MPI_INT, dst, /* tag */ 0,
+						MPI_COMM_WORLD, &handles[1]);
+					MPI_Waitall(2, handles, MPI_STATUSES_IGNORE);
+					auto end = steady_clock::now();
+
+					elapsed = duration<double, micro>(end - begin).count();
+					peer = dst;
+				} else if (rank == 0) {
+					int current_receiver = schedule[v];
+					int items_acked = 0;
+
+					auto begin = steady_clock::now();
+					MPI_Send(sendbuf, numints, MPI_INT, /* dst */ current_receiver, /* tag */ 0, MPI_COMM_WORLD);
+					MPI_Recv(&items_acked, 1, MPI_INT, /* source */ current_receiver,
+							 MPI_ANY_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+					auto end = steady_clock::now();
+
+					assert(items_acked == numints);
+					elapsed = duration<double, micro>(end - begin).count();
+					peer = current_receiver;
+				} else if (rank == schedule[v]) {
+					int items_received = 0;
+					MPI_Status status;
+
+					MPI_Recv(recvbuf, numints, MPI_INT, /* source */ 0,
+						MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+					MPI_Get_count(&status, MPI_INT, &items_received);
+					MPI_Send(&items_received, 1, MPI_INT, /* dst */ 0,
+						/* tag */ 0, MPI_COMM_WORLD);
+				}
+
+				if (elapsed >= 0) {
+					if (!contacted[peer])
+						cold.push_back(elapsed);
+					else if (peer != prev_peer)
+						switched.push_back(elapsed);
+					else
+						steady.push_back(elapsed);
+					contacted[peer] = true;
+					prev_peer = peer;
+
+					// poll over the wait period:
+					int64_t start = get_us();
+					while ((get_us() - start) < wait_us) {}
+				}
+			}
+		}
+
+		if (rank == 0) {
+			sort(cold.begin(), cold.end());
+			sort(switched.begin(), switched.end());
+			sort(steady.begin(), steady.end());
+
+			cout << order_names[o] << " " << Nreceivers << " " << numints * sizeof(int)
+				<< " " << wait_us << " " << cold.size() << " "
+				<< (cold.empty() ? 0 : percentile(cold, 0.5)) << " " << switched.size() << " "
+				<< (switched.empty() ? 0 : percentile(switched, 0.5)) << " "
+				<< (switched.empty() ? 0 : percentile(switched, 0.99)) << " " << steady.size() << " "
+				<< (steady.empty() ? 0 : percentile(steady, 0.5)) << " "
+				<< (steady.empty() ? 0 : percentile(steady, 0.99)) << " "
+				<< (switched.empty() || steady.empty() ? 0 :
+					percentile(switched, 0.5) - percentile(steady, 0.5)) << endl;
+		}
+	}
+	}
+	}
+	}
+
+	delete [] sendbuf;
+	delete [] recvbuf;
+}
+
+volatile double compute_sink; // keeps the compute kernel from being optimized away
+
+// the compute kernel: a dependent floating-point chain of the given length
+void compute(int64_t units) {
+	double x = 1.0;
+	for (int64_t i = 0; i < units; i++)
+		x = x * 1.0000001 + 1e-9;
+	compute_sink = x;
+}
+
+// compute for the given number of units, calling MPI_Test on req every test_units (0 = never)
+void compute_and_test(int64_t units, int64_t test_units, MPI_Request *req) {
+	if (test_units == 0) {
+		compute(units);
+		return;
+	}
+	int flag = 0;
+	for (int64_t done = 0; done < units; done += test_units) {
+		compute(min(test_units, units - done));
+		if (!flag)
+			MPI_Test(req, &flag, MPI_STATUS_IGNORE);
+	}
+}
+
+// kernel units per microsecond on this core
+double calibrate_compute() {
+	const int64_t units = 10000000;
+	compute(units / 10); // warm up
+	auto begin = steady_clock::now();
+	compute(units);
+	auto end = steady_clock::now();
+	return units / duration<double, micro>(end - begin).count();
+}
+
+// one transfer from rank 0 to rank 1, computing for compute_units in between post and wait;
+// returns this rank's time from post to completion in microseconds
+double overlap_transfer(int rank, int * buf, int count, int64_t compute_units, int64_t test_units) {
+	MPI_Request req;
+
+	MPI_Barrier(MPI_COMM_WORLD);
+	auto begin = steady_clock::now();
+	if (rank == 0)
+		MPI_Isend(buf, count, MPI_INT, /* dst */ 1, /* tag */ 0, MPI_COMM_WORLD, &req);
+	else
+		MPI_Irecv(buf, count, MPI_INT, /* source */ 0, /* tag */ 0, MPI_COMM_WORLD, &req);
+	compute_and_test(compute_units, test_units, &req);
+	MPI_Wait(&req, MPI_STATUS_IGNORE);
+	auto end = steady_clock::now();
+
+	return duration<double, micro>(end - begin).count();
+}
+
+// median over OVERLAP_ITERS transfers
+double overlap_median(int rank, int * buf, int count, int64_t compute_units, int64_t test_units) {
+	vector<double> times(OVERLAP_ITERS);
+	for (int i = 0; i < OVERLAP_ITERS; i++)
+		times[i] = overlap_transfer(rank, buf, count, compute_units, test_units);
+	sort(times.begin(), times.end());
+	return times[OVERLAP_ITERS / 2];
+}
+
+// fraction of the shorter of compute and communication hidden behind the other, in percent
+double overlap_percent(double comm, double comp, double total) {
+	double hidden = comm + comp - total;
+	double pct = 100 * hidden / min(comm, comp);
+	return max(0.0, min(100.0, pct));
+}
+
+void overlap_test(int size, int rank) {
+
+	int Nsizes = sizeof(OVERLAP_ITEM_COUNTS) / sizeof(OVERLAP_ITEM_COUNTS[0]);
+	int Nintervals = sizeof(OVERLAP_TEST_US) / sizeof(OVERLAP_TEST_US[0]);
+	int maxcount = *max_element(OVERLAP_ITEM_COUNTS, OVERLAP_ITEM_COUNTS + Nsizes);
+
+	if (rank > 1) { // only ranks 0 and 1 take part, the rest just match the barriers
+		int Nbarriers = (1 + Nsizes * (1 + Nintervals)) * OVERLAP_ITERS;
+		for (int i = 0; i < Nbarriers; i++)
+			MPI_Barrier(MPI_COMM_WORLD);
+		return;
+	}
+
+	int * buf = new int[maxcount];
+	for (int i = 0; i < maxcount; i++)
+		buf[i] = i;
+
+	double units_per_us = calibrate_compute();
+	int64_t compute_units = (int64_t)(units_per_us * OVERLAP_COMPUTE_US);
+
+	// compute alone, timed the same way as the transfers
+	vector<double> comp_times(OVERLAP_ITERS);
+	for (int i = 0; i < OVERLAP_ITERS; i++) {
+		MPI_Barrier(MPI_COMM_WORLD);
+		auto begin = steady_clock::now();
+		compute(compute_units);
+		comp_times[i] = duration<double, micro>(steady_clock::now() - begin).count();
+	}
+	sort(comp_times.begin(), comp_times.end());
+	double comp = comp_times[OVERLAP_ITERS / 2];
+
+	if (rank == 0) {
+		cout << "Overlap of a " << OVERLAP_COMPUTE_US << " us compute kernel (measured " << comp
+			<< " us) with one transfer, median of " << OVERLAP_ITERS << ":" << endl;
+		cout << "bytes test_every_us send_comm_us send_total_us send_overlap_pct"
+			<< " recv_comm_us recv_total_us recv_overlap_pct" << endl;
+	}
+
+	for (int s = 0; s < Nsizes; s++) {
+		int count = OVERLAP_ITEM_COUNTS[s];
+
+		// communication alone; each rank reports its own post-to-completion time
+		double comm = overlap_median(rank, buf, count, 0, 0);
+		double peer_comm = comm;
+		if (rank == 1)
+			MPI_Send(&comm, 1, MPI_DOUBLE, /* dst */ 0, /* tag */ 1, MPI_COMM_WORLD);
+		else
+			MPI_Recv(&peer_comm, 1, MPI_DOUBLE, /* source */ 1, /* tag */ 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+		for (int t = 0; t < Nintervals; t++) {
+			int64_t test_units = (int64_t)(units_per_us * OVERLAP_TEST_US[t]);
+			double total = overlap_median(rank, buf, count, compute_units, test_units);
+
+			double peer_total = total;
+			if (rank == 1)
+				MPI_Send(&total, 1, MPI_DOUBLE, /* dst */ 0, /* tag */ 1, MPI_COMM_WORLD);
+			else
+				MPI_Recv(&peer_total, 1, MPI_DOUBLE, /* source */ 1, /* tag */ 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+			if (rank == 0) {
+				cout << count * sizeof(int) << " " << OVERLAP_TEST_US[t] << " "
+					<< comm << " " << total << " " << overlap_percent(comm, comp, total) << " "
+					<< peer_comm << " " << peer_total << " " << overlap_percent(peer_comm, comp, peer_total) << endl;
+			}
+		}
+	}
+
+	delete [] buf;
+}
 
 void delayed_message_stream_test(int size, int rank) {
 	
@@ -9,11 +9,16 @@
 #include <fstream>
 #include <algorithm>
 
+#include "dccs_affinity.h"
+
 // this is to test MPI_COMM_SPLIT controller (for multiple staggered rotors)
 
 const int64_t run_us = 300299; // total runtime, microseconds
 const int64_t slot_us = 300; // slot time, microseconds
 
+const char * PIN_POLICY = "compact"; // or "scatter", "none", "list:0,2,4-7" (see dccs_affinity.h)
+
+void pin_rank(int rank);
 void rotor_test(int size, int rank);
 
 using namespace std;
@@ -37,6 +42,8 @@ int main(int argc, char* argv[])
 	MPI_Comm_size(MPI_COMM_WORLD, &size);
 	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
+	pin_rank(rank);
+
 	rotor_test(size, rank);
 
 	MPI_Finalize();
@@ -44,6 +51,19 @@ int main(int argc, char* argv[])
 	return 0;
 }
 
+// pin this rank to its own core among the ranks on its host, and report it
+void pin_rank(int rank) {
+
+	dccs_binding binding;
+	char description[256];
+
+	if (affinity_pin(PIN_POLICY, NULL, affinity_local_rank(MPI_COMM_WORLD), &binding) != 0)
+		cerr << "rank = " << rank << ", failed to pin: " << strerror(errno) << endl;
+
+	affinity_describe(&binding, description, sizeof(description));
+	cout << "rank = " << rank << ", " << description << endl;
+}
+
 void rotor_test(int size, int rank) {
 	
 	int Nslots = run_us / slot_us; // total number of slots
@@ -0,0 +1,5 @@
+#!/bin/bash
+
+export CXX=mpicxx
+
+make
@@ -0,0 +1,322 @@
+#include <mpi.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include "rotor_coll.h"
+
+using namespace std;
+
+static int chunk_bytes = ROTOR_COLL_CHUNK_BYTES;
+
+void rotor_coll_set_chunk_bytes(int bytes) {
+	chunk_bytes = bytes > 0 ? bytes : 0;
+}
+
+int rotor_coll_chunk_bytes(void) {
+	return chunk_bytes;
+}
+
+/* Rotor shift schedule */
+
+// peers of rank in slot s of one rotor cycle; slot 0 is the rank itself
+static inline int rotor_dst(int rank, int size, int slot) { return (rank + slot) % size; }
+static inline int rotor_src(int rank, int size, int slot) { return (rank - slot + size) % size; }
+
+static inline char * offset(const void *buf, MPI_Aint extent, MPI_Aint count) {
+	return (char *)buf + extent * count;
+}
+
+static MPI_Aint type_extent(MPI_Datatype type) {
+	MPI_Aint lb, extent;
+	MPI_Type_get_extent(type, &lb, &extent);
+	return extent;
+}
+
+// elements per chunk for a transfer of count elements of type
+static int chunk_count(int count, MPI_Datatype type) {
+	int type_size;
+	MPI_Type_size(type, &type_size);
+	if (chunk_bytes == 0 || type_size == 0)
+		return max(count, 1);
+	return min(max(chunk_bytes / type_size, 1), max(count, 1));
+}
+
+/* Slot engine */
+
+// One rotor slot: stream sendcount elements to dst and receive recvcount
+// elements from src, in chunks with up to ROTOR_COLL_DEPTH chunks in flight
+// each way. If op is not MPI_OP_NULL, received chunks land in a staging
+// ring and are reduced into recvbuf as soon as each one completes, while
+// the following chunks are still on the wire.
+static int rotor_slot(const void *sendbuf, int sendcount, MPI_Datatype sendtype, int dst,
+	void *recvbuf, int recvcount, MPI_Datatype recvtype, int src,
+	MPI_Op op, MPI_Comm comm) {
+
+	MPI_Aint sext = type_extent(sendtype);
+	MPI_Aint rext = type_extent(recvtype);
+	int schunk = chunk_count(sendcount, sendtype);
+	int rchunk = chunk_count(recvcount, recvtype);
+	int Nsend = (sendcount + schunk - 1) / schunk;
+	int Nrecv = (recvcount + rchunk - 1) / rchunk;
+	bool reduce = op != MPI_OP_NULL;
+
+	// only as many staging chunks as can be in flight at once:
+	vector<char> staging;
+	if (reduce)
+		staging.resize((size_t)(rext * rchunk) * min(Nrecv, ROTOR_COLL_DEPTH));
+
+	// requests [0, DEPTH) are receives, [DEPTH, 2 * DEPTH) are sends:
+	MPI_Request handles[2 * ROTOR_COLL_DEPTH];
+	int chunk_of[ROTOR_COLL_DEPTH]; // chunk index of each posted receive
+	for (int k = 0; k < 2 * ROTOR_COLL_DEPTH; k++)
+		handles[k] = MPI_REQUEST_NULL;
+
+	int next_recv = 0, next_send = 0, pending = 0;
+	int rc = MPI_SUCCESS;
+
+	auto post_recv = [&](int k) -> int {
+		int c = next_recv++;
+		int n = min(rchunk, recvcount - c * rchunk);
+		void *dst_ptr = reduce ? &staging[(size_t)(rext * rchunk) * k]
+			: offset(recvbuf, rext, (MPI_Aint)c * rchunk);
+		chunk_of[k] = c;
+		pending++;
+		return MPI_Irecv(dst_ptr, n, recvtype, src, ROTOR_COLL_TAG, comm, &handles[k]);
+	};
+	auto post_send = [&](int k) -> int {
+		int c = next_send++;
+		int n = min(schunk, sendcount - c * schunk);
+		pending++;
+		return MPI_Isend(offset(sendbuf, sext, (MPI_Aint)c * schunk), n, sendtype, dst,
+			ROTOR_COLL_TAG, comm, &handles[ROTOR_COLL_DEPTH + k]);
+	};
+
+	// receives first, so the peer's first chunk finds a posted buffer:
+	for (int k = 0; k < ROTOR_COLL_DEPTH && next_recv < Nrecv; k++)
+		rc = post_recv(k);
+	for (int k = 0; k < ROTOR_COLL_DEPTH && next_send < Nsend; k++)
+		rc = post_send(k);
+
+	while (pending > 0 && rc == MPI_SUCCESS) {
+		int idx;
+		rc = MPI_Waitany(2 * ROTOR_COLL_DEPTH, handles, &idx, MPI_STATUS_IGNORE);
+		if (rc != MPI_SUCCESS || idx == MPI_UNDEFINED)
+			break;
+		pending--;
+
+		if (idx < ROTOR_COLL_DEPTH) {
+			if (reduce) {
+				int c = chunk_of[idx];
+				int n = min(rchunk, recvcount - c * rchunk);
+				// in-slot reduction: recvbuf = chunk op recvbuf
+				rc = MPI_Reduce_local(&staging[(size_t)(rext * rchunk) * idx],
+					offset(recvbuf, rext, (MPI_Aint)c * rchunk), n, recvtype, op);
+			}
+			if (next_recv < Nrecv && rc == MPI_SUCCESS)
+				rc = post_recv(idx);
+		} else {
+			if (next_send < Nsend)
+				rc = post_send(idx - ROTOR_COLL_DEPTH);
+		}
+	}
+
+	return rc;
+}
+
+static bool commutative(MPI_Op op) {
+	int commute = 0;
+	MPI_Op_commutative(op, &commute);
+	return commute != 0;
+}
+
+/* Collectives */
+
+int rotor_alltoall(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+	void *recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm) {
+
+	int size, rank, rc = MPI_SUCCESS;
+	MPI_Comm_size(comm, &size);
+	MPI_Comm_rank(comm, &rank);
+
+	vector<char> copy;
+	if (sendbuf == MPI_IN_PLACE) {
+		copy.assign((char *)recvbuf, offset(recvbuf, type_extent(recvtype), (MPI_Aint)recvcount * size));
+		sendbuf = copy.data();
+		sendcount = recvcount;
+		sendtype = recvtype;
+	}
+
+	MPI_Aint sext = type_extent(sendtype);
+	MPI_Aint rext = type_extent(recvtype);
+
+	for (int slot = 0; slot < size && rc == MPI_SUCCESS; slot++) {
+		int dst = rotor_dst(rank, size, slot);
+		int src = rotor_src(rank, size, slot);
+		rc = rotor_slot(offset(sendbuf, sext, (MPI_Aint)dst * sendcount), sendcount, sendtype, dst,
+			offset(recvbuf, rext, (MPI_Aint)src * recvcount), recvcount, recvtype, src,
+			MPI_OP_NULL, comm);
+	}
+	return rc;
+}
+
+int rotor_alltoallv(const void *sendbuf, const int sendcounts[], const int sdispls[],
+	MPI_Datatype sendtype, void *recvbuf, const int recvcounts[], const int rdispls[],
+	MPI_Datatype recvtype, MPI_Comm comm) {
+
+	int size, rank, rc = MPI_SUCCESS;
+	MPI_Comm_size(comm, &size);
+	MPI_Comm_rank(comm, &rank);
+
+	vector<char> copy;
+	if (sendbuf == MPI_IN_PLACE) {
+		MPI_Aint end = 0;
+		for (int i = 0; i < size; i++)
+			end = max(end, (MPI_Aint)rdispls[i] + recvcounts[i]);
+		copy.assign((char *)recvbuf, offset(recvbuf, type_extent(recvtype), end));
+		sendbuf = copy.data();
+		sendcounts = recvcounts;
+		sdispls = rdispls;
+		sendtype = recvtype;
+	}
+
+	MPI_Aint sext = type_extent(sendtype);
+	MPI_Aint rext = type_extent(recvtype);
+
+	for (int slot = 0; slot < size && rc == MPI_SUCCESS; slot++) {
+		int dst = rotor_dst(rank, size, slot);
+		int src = rotor_src(rank, size, slot);
+		rc = rotor_slot(offset(sendbuf, sext, sdispls[dst]), sendcounts[dst], sendtype, dst,
+			offset(recvbuf, rext, rdispls[src]), recvcounts[src], recvtype, src,
+			MPI_OP_NULL, comm);
+	}
+	return rc;
+}
+
+int rotor_allgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+	void *recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm) {
+
+	int size, rank, rc = MPI_SUCCESS;
+	MPI_Comm_size(comm, &size);
+	MPI_Comm_rank(comm, &rank);
+
+	MPI_Aint rext = type_extent(recvtype);
+
+	// with MPI_IN_PLACE our block is already in place, so skip slot 0:
+	int first_slot = 0;
+	if (sendbuf == MPI_IN_PLACE) {
+		sendbuf = offset(recvbuf, rext, (MPI_Aint)rank * recvcount);
+		sendcount = recvcount;
+		sendtype = recvtype;
+		first_slot = 1;
+	}
+
+	for (int slot = first_slot; slot < size && rc == MPI_SUCCESS; slot++) {
+		int src = rotor_src(rank, size, slot);
+		rc = rotor_slot(sendbuf, sendcount, sendtype, rotor_dst(rank, size, slot),
+			offset(recvbuf, rext, (MPI_Aint)src * recvcount), recvcount, recvtype, src,
+			MPI_OP_NULL, comm);
+	}
+	return rc;
+}
+
+int rotor_bcast(void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm) {
+
+	int size, rank, rc = MPI_SUCCESS;
+	MPI_Comm_size(comm, &size);
+	MPI_Comm_rank(comm, &rank);
+
+	// the root's slot s peer is root + s, so every rank hears from it in one slot:
+	if (rank == root) {
+		for (int slot = 1; slot < size && rc == MPI_SUCCESS; slot++)
+			rc = rotor_slot(buffer, count, datatype, rotor_dst(root, size, slot),
+				NULL, 0, datatype, MPI_PROC_NULL, MPI_OP_NULL, comm);
+	} else {
+		rc = rotor_slot(NULL, 0, datatype, MPI_PROC_NULL,
+			buffer, count, datatype, root, MPI_OP_NULL, comm);
+	}
+	return rc;
+}
+
+int rotor_reduce_scatter(const void *sendbuf, void *recvbuf, const int recvcounts[],
+	MPI_Datatype datatype, MPI_Op op, MPI_Comm comm) {
+
+	if (!commutative(op))
+		return MPI_Reduce_scatter(sendbuf, recvbuf, recvcounts, datatype, op, comm);
+
+	int size, rank, rc = MPI_SUCCESS;
+	MPI_Comm_size(comm, &size);
+	MPI_Comm_rank(comm, &rank);
+
+	MPI_Aint ext = type_extent(datatype);
+	vector<MPI_Aint> displs(size + 1, 0);
+	for (int i = 0; i < size; i++)
+		displs[i + 1] = displs[i] + recvcounts[i];
+
+	vector<char> copy;
+	if (sendbuf == MPI_IN_PLACE) {
+		copy.assign((char *)recvbuf, offset(recvbuf, ext, displs[size]));
+		sendbuf = copy.data();
+	}
+
+	// slot 0 seeds our block with our own contribution, later slots reduce into it:
+	for (int slot = 0; slot < size && rc == MPI_SUCCESS; slot++) {
+		int dst = rotor_dst(rank, size, slot);
+		rc = rotor_slot(offset(sendbuf, ext, displs[dst]), recvcounts[dst], datatype, dst,
+			recvbuf, recvcounts[rank], datatype, rotor_src(rank, size, slot),
+			slot == 0 ? MPI_OP_NULL : op, comm);
+	}
+	return rc;
+}
+
+int rotor_reduce_scatter_block(const void *sendbuf, void *recvbuf, int recvcount,
+	MPI_Datatype datatype, MPI_Op op, MPI_Comm comm) {
+
+	int size;
+	MPI_Comm_size(comm, &size);
+
+	if (!commutative(op))
+		return MPI_Reduce_scatter_block(sendbuf, recvbuf, recvcount, datatype, op, comm);
+
+	vector<int> recvcounts(size, recvcount);
+	return rotor_reduce_scatter(sendbuf, recvbuf, recvcounts.data(), datatype, op, comm);
+}
+
+// reduce-scatter over size nearly equal blocks, then an allgather of the blocks
+int rotor_allreduce(const void *sendbuf, void *recvbuf, int count,
+	MPI_Datatype datatype, MPI_Op op, MPI_Comm comm) {
+
+	if (!commutative(op))
+		return MPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm);
+
+	int size, rank, rc = MPI_SUCCESS;
+	MPI_Comm_size(comm, &size);
+	MPI_Comm_rank(comm, &rank);
+
+	MPI_Aint ext = type_extent(datatype);
+	vector<int> counts(size);
+	vector<MPI_Aint> displs(size, 0);
+	for (int i = 0; i < size; i++) {
+		counts[i] = count / size + (i < count % size ? 1 : 0);
+		if (i > 0)
+			displs[i] = displs[i - 1] + counts[i - 1];
+	}
+
+	vector<char> copy;
+	if (sendbuf == MPI_IN_PLACE) {
+		copy.assign((char *)recvbuf, offset(recvbuf, ext, count));
+		sendbuf = copy.data();
+	}
+
+	rc = rotor_reduce_scatter(sendbuf, offset(recvbuf, ext, displs[rank]), counts.data(),
+		datatype, op, comm);
+
+	for (int slot = 1; slot < size && rc == MPI_SUCCESS; slot++) {
+		int src = rotor_src(rank, size, slot);
+		rc = rotor_slot(offset(recvbuf, ext, displs[rank]), counts[rank], datatype,
+			rotor_dst(rank, size, slot),
+			offset(recvbuf, ext, displs[src]), counts[src], datatype, src,
+			MPI_OP_NULL, comm);
+	}
+	return rc;
+}
@@ -0,0 +1,59 @@
+// Collectives on the rotor slot schedule.
+//
+// Every collective runs one rotor cycle over the communicator: in slot s
+// (1..size-1), rank r sends to r + s and receives from r - s, the
+// shift-based matchings used by rlb_v1. The data exchanged in a slot is
+// split into chunks of rotor_coll_chunk_bytes() and pipelined, and
+// reductions are applied chunk by chunk as chunks arrive.
+//
+// Signatures match the corresponding MPI-3 collectives, including
+// MPI_IN_PLACE. Restrictions:
+//  - chunking requires the send and receive datatypes of a transfer to
+//    have the same size (always true for matching basic types);
+//  - non-commutative reduction ops fall back to the MPI library;
+//  - point-to-point traffic on ROTOR_COLL_TAG must not be pending on the
+//    communicator during a call.
+
+#ifndef ROTOR_COLL_H
+#define ROTOR_COLL_H
+
+#include <mpi.h>
+
+#define ROTOR_COLL_TAG 0x524c // "RL"
+#define ROTOR_COLL_CHUNK_BYTES 65536 // default pipelining chunk
+#define ROTOR_COLL_DEPTH 4 // chunks in flight per direction
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// set the pipelining chunk size; 0 sends each slot's data as one message
+void rotor_coll_set_chunk_bytes(int bytes);
+int rotor_coll_chunk_bytes(void);
+
+int rotor_alltoall(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+	void *recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm);
+
+int rotor_alltoallv(const void *sendbuf, const int sendcounts[], const int sdispls[],
+	MPI_Datatype sendtype, void *recvbuf, const int recvcounts[], const int rdispls[],
+	MPI_Datatype recvtype, MPI_Comm comm);
+
+int rotor_allgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+	void *recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm);
+
+int rotor_bcast(void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm);
+
+int rotor_reduce_scatter_block(const void *sendbuf, void *recvbuf, int recvcount,
+	MPI_Datatype datatype, MPI_Op op, MPI_Comm comm);
+
+int rotor_reduce_scatter(const void *sendbuf, void *recvbuf, const int recvcounts[],
+	MPI_Datatype datatype, MPI_Op op, MPI_Comm comm);
+
+int rotor_allreduce(const void *sendbuf, void *recvbuf, int count,
+	MPI_Datatype datatype, MPI_Op op, MPI_Comm comm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ROTOR_COLL_H
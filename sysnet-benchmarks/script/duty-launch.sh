@@ -0,0 +1,37 @@
+#!/usr/bin/env bash
+
+# Check if MPI environment is loaded
+if ! [ -x "$(command -v mpirun)" ]; then
+    source ./setup-hpcx.sh
+fi
+
+# Config
+execname=../build/duty_exec
+hostfile=hosts.config
+hosts=$(cat $hostfile| paste -s -d "," -)
+np=$(cat $hostfile | wc -l)
+
+# MPI only starts the ranks and gathers results, cycles go over the transport's writes
+FLAGS+="--allow-run-as-root -bind-to none "
+
+# Executable flags: 1000 cycles of 180µsec up and 20µsec down, per length
+length="64:1048576:4"   # --length-range sweep, efficiency per message size
+count=1000
+warmup=10
+uptime_us=180
+downtime_us=20
+window=16       # writes in flight to a peer
+rotate="--rotate"   # next peer every cycle, or "" to keep one
+port=1234       # rank r listens on port + r
+pin="compact"
+transport=verbs # or mpi, shm (one host) or tcp
+
+# Launch MPI job
+set -x
+if [[ $length == *:* ]]; then
+    lengthflags="--length-range=$length"
+else
+    lengthflags="-b $length"
+fi
+execflags="$lengthflags -r $count -w $warmup --duty-cycle=$uptime_us:$downtime_us --window=$window $rotate -p $port --pin=$pin --transport=$transport"
+mpirun -np $np --host $hosts $FLAGS $execname $execflags
@@ -1,6 +1,6 @@
 #!/usr/bin/env bash
 
 sudo apt-get install -y iperf perftest
-sudo apt-get install -y bc cmake libssl-dev pssh
+sudo apt-get install -y bc cmake pssh
 sudo apt-get install -y dos2unix
 
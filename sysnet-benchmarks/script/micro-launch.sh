@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+
+# Check if MPI environment is loaded
+if ! [ -x "$(command -v mpirun)" ]; then
+    source ./setup-hpcx.sh
+fi
+
+# Config
+execname=../build/micro_exec
+hostfile=hosts.config
+hosts=$(cat $hostfile| paste -s -d "," -)
+np=2            # Ranks 0 and 1 run the benchmark, others only set it up
+
+# MPI only starts the ranks, messages go over the transport
+FLAGS+="--allow-run-as-root -bind-to none "
+
+# Executable flags
+length="2:1048576:2"
+mode=latency    # or throughput
+verb=send       # or write, write-imm
+count=10000
+warmup=100
+window=64       # messages in flight in throughput mode
+port=1234       # rank r listens on port + r
+pin="compact"
+transport=verbs # or mpi, shm (one host) or tcp
+
+# Launch MPI job
+set -x
+if [[ $length == *:* ]]; then
+    lengthflags="--length-range=$length"
+else
+    lengthflags="-b $length"
+fi
+execflags="$lengthflags -m $mode -v $verb -r $count -w $warmup --window=$window -p $port --pin=$pin --transport=$transport"
+mpirun -np $np --host $hosts $FLAGS $execname $execflags
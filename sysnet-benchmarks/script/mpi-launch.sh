@@ -17,7 +17,7 @@ np=$(cat $hostfile | wc -l)
 HCAS=mlx5_0:1
 FLAGS+="-mca btl_openib_warn_default_gid_prefix 0 "
 FLAGS+="-mca btl_openib_warn_no_device_params_found 0 "
-FLAGS+="--report-bindings --allow-run-as-root -bind-to core "
+FLAGS+="--allow-run-as-root -bind-to none "
 FLAGS+="-mca coll_fca_enable 0 -mca coll_hcoll_enable 0 "
 #FLAGS+="-mca pml yalla "
 FLAGS+="-mca mtl_mxm_np 0 -x MXM_TLS=ud,shm,self -x MXM_RDMA_PORTS=$HCAS "
@@ -29,7 +29,7 @@ FLAGS+="-x MXM_IB_MAP_MODE=round-robin -x MXM_IB_USE_GRH=y "
 FLAGS+="-mca btl_openib_receive_queues P,65536,256,192,128:S,128,256,192,128:S,2048,1024,1008,64:S,12288,1024,1008,64:S,65536,1024,1008,64 "
 
 # Executable flags
-l=1024
+min_length=1024
 #limit=1024
 limit=$((1024*1024*1024))
 count=1
@@ -38,14 +38,22 @@ mode="throughput"
 warmup=0
 mr_count=1
 direction="1-N"
+timing="local"  # "epoch" times all ranks from a common synchronized start
+schedule="all"  # N-N only: "shift" (rotor), "xor" or "random" exchange one peer per step
+pacing="completion"  # or "slot:<µsec>" to start each step on a local slot timer
+pin="compact"   # "scatter", "none" or "list:<cpus>"; ranks report their CPU
+windows="64"
+#windows="1 2 4 8 16 32 64 128 256"  # sweep the in-flight window
 
 # Launch MPI job
 set -x
-while [[ $l -le $limit ]]; do
-    echo "Length = $l ..."
-    execflags="-b $l -r $count -v $verb -m $mode -w $warmup --mr_count=$mr_count --direction=$direction"
+# Each run sweeps all lengths in one process
+for window in $windows; do
+    echo "Window = $window ..."
+    execflags="--length-range=$min_length:$limit:2 -r $count -v $verb -m $mode -w $warmup --mr_count=$mr_count --direction=$direction --window=$window --timing=$timing --schedule=$schedule --pacing=$pacing --pin=$pin"
+    # Rank 0 writes one summary record per length and round, see process_mpi_result.py --mpi-summaries
+    execflags+=" --output=summary-$direction-$schedule-w$window.csv"
     mpirun -np $np --host $hosts $FLAGS $execname $execflags
-    (( l *= 2 ))
     echo ""
 done
 
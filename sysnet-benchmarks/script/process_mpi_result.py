@@ -1,7 +1,7 @@
 #!/usr/bin/env python
 # coding=utf-8
 
-import argparse, re, os
+import argparse, csv, re, os
 import numpy as np
 import matplotlib.pyplot as plt
 
@@ -9,9 +9,12 @@ import matplotlib.pyplot as plt
 ROUNDS = 10
 
 parser = argparse.ArgumentParser()
-parser.add_argument('--mpi-logs', required=False, nargs='+', type=argparse.FileType('r'), help='MPI Log file')
+parser.add_argument('--mpi-logs', required=False, nargs='+', type=argparse.FileType('r'), help='MPI Log file (mpi_exec -V, for its per-rank lines)')
+parser.add_argument('--mpi-summaries', required=False, nargs='+', type=argparse.FileType('r'), help='MPI summary CSV file (mpi_exec --output)')
+parser.add_argument('--warmup-rounds', default=2, type=int, help='Leading rounds of each --mpi-summaries run to skip as warmup (default: 2)')
 parser.add_argument('--rdma-logs', required=False, nargs='+', type=argparse.FileType('r'), help='Mellanox RDMA Log file')
 parser.add_argument('-m', '--metric', required=True, choices=[ 'latency', 'throughput' ], help='Which metric to plot, "latency" or "throughput"')
+parser.add_argument('-x', '--x-axis', default='length', choices=[ 'length', 'window' ], help='Plot against message length (one line per window) or in-flight window (one line per length)')
 parser.add_argument('-s', '--stats', required=True, choices=[ 'avg', 'errorbar', 'min', 'max' ], nargs='+', help='Which stat to print, "avg", "errorbar", "min", or "max"')
 args = parser.parse_args()
 
@@ -23,22 +26,17 @@ def plot_mpi_logfile(logfile):
     #with open(logfile) as f:
     with logfile as f:
         for line in f:
-            # arr = filter(None, line.split(' '))
-            # round = int(arr[0])
-            # rank = int(arr[1])
-            # bytes = int(arr[2])
-            # elapsed = float(arr[3])
-            # throughput = float(arr[4])
-
-            m = re.compile(r'^\[info\]  round = (\d+), rank = (\d+), bytes recv\'d = (\d+), elapsed = ([\d|\.]+)µsec, throughput = ([\d|\.]+) gbits.$').match(line)
+            # Older logs have no window field
+            m = re.compile(r'^\[info\]  round = (\d+), rank = (\d+), (?:window = (\d+), )?bytes recv\'d = (\d+), elapsed = ([\d|\.]+)µsec, throughput = ([\d|\.]+) gbits.$').match(line)
             if not m:
                 continue
 
             round = int(m.group(1))
             rank = int(m.group(2))
-            bytes = int(m.group(3))
-            elapsed = float(m.group(4))
-            throughput = float(m.group(5))
+            window = int(m.group(3)) if m.group(3) else 0
+            bytes = int(m.group(4))
+            elapsed = float(m.group(5))
+            throughput = float(m.group(6))
 
             if min_bytes == 0:
                 min_bytes = bytes
@@ -51,16 +49,15 @@ def plot_mpi_logfile(logfile):
             if round < 2 or round >= ROUNDS - 1:
                 continue
 
-            if bytes not in entries:
-                entries[bytes] = []
-            entries[bytes].append([round, rank, elapsed, throughput])
+            key = (window, bytes)
+            if key not in entries:
+                entries[key] = []
+            entries[key].append([round, rank, elapsed, throughput])
 
     ranks = max_rank + 1
-    data = {}
-    stdevs = {}
-    for k, v in entries.iteritems():
-        bytes = k
-        arr = v
+    # One line per window when plotting against length, and vice versa
+    series = {}
+    for (window, bytes), v in entries.iteritems():
         t = {}
         for [round, rank, elapsed, throughput] in v:
             # Use round if 1-N and N-1, and (round, rank) for N-N
@@ -73,35 +70,98 @@ def plot_mpi_logfile(logfile):
                 t[(round, rank)] = 0
             t[(round, rank)] += metric
 
-        # print [v for v in t.itervalues()]
         avgv = sum(t.itervalues()) / len(t)
         minv = min(t.itervalues())
         maxv = max(t.itervalues())
         stdev = np.std([v for v in t.itervalues()])
-        data[bytes] = (minv, avgv, maxv)
-        stdevs[bytes] = stdev
-        # print bytes, avgv, minv, maxv, stdev
-        # for round, throughput in t.iteritems():
-            # print bytes, round, throughput
 
-    N = len(data)
-    np_x = np.array([bytes for bytes, _ in sorted(data.iteritems())])
-    np_avg = np.array([item[1] for _, item in sorted(data.iteritems())])
-    np_std = np.array([stdev for _, stdev in sorted(stdevs.iteritems())])
-    np_min = np.array([item[0] for _, item in sorted(data.iteritems())])
-    np_max = np.array([item[2] for _, item in sorted(data.iteritems())])
+        if args.x_axis == 'window':
+            line, x = bytes, window
+        else:
+            line, x = window, bytes
+        if line not in series:
+            series[line] = ({}, {})
+        series[line][0][x] = (minv, avgv, maxv)
+        series[line][1][x] = stdev
 
     name = os.path.basename(logfile.name).split('.')[0]
-    if 'errorbar' in args.stats:
-        plt.errorbar(np_x, np_avg, np_std, label='%s - errorbar' % name, marker='.', linewidth=0.75)
-    if 'avg' in args.stats:
-        plt.plot(np_x, np_avg, label='%s - avg' % name, marker='.', linewidth=0.75)
-    if 'min' in args.stats:
-        plt.plot(np_x, np_min, label='%s - min' % name, marker=".", linewidth=0.75)
-    if 'max' in args.stats:
-        plt.plot(np_x, np_max, label='%s - max' % name, marker=".", linewidth=0.75)
+    xs = []
+    for line, (data, stdevs) in sorted(series.iteritems()):
+        np_x = np.array([x for x, _ in sorted(data.iteritems())])
+        np_avg = np.array([item[1] for _, item in sorted(data.iteritems())])
+        np_std = np.array([stdev for _, stdev in sorted(stdevs.iteritems())])
+        np_min = np.array([item[0] for _, item in sorted(data.iteritems())])
+        np_max = np.array([item[2] for _, item in sorted(data.iteritems())])
+        xs.extend(np_x)
 
-    return (min(np_x), max(np_x))
+        label = name
+        if len(series) > 1 or args.x_axis == 'window':
+            label = '%s (%s = %d)' % (name, 'window' if args.x_axis == 'length' else 'length', line)
+        if 'errorbar' in args.stats:
+            plt.errorbar(np_x, np_avg, np_std, label='%s - errorbar' % label, marker='.', linewidth=0.75)
+        if 'avg' in args.stats:
+            plt.plot(np_x, np_avg, label='%s - avg' % label, marker='.', linewidth=0.75)
+        if 'min' in args.stats:
+            plt.plot(np_x, np_min, label='%s - min' % label, marker=".", linewidth=0.75)
+        if 'max' in args.stats:
+            plt.plot(np_x, np_max, label='%s - max' % label, marker=".", linewidth=0.75)
+
+    return (min(xs), max(xs))
+
+def plot_mpi_summary(summary):
+    # One record per (length, round) with stats across ranks already reduced
+    entries = {}
+    with summary as f:
+        for row in csv.DictReader(f):
+            key = (int(row['window']), int(row['length']))
+            if key not in entries:
+                entries[key] = []
+            entries[key].append(row)
+
+    metric = 'elapsed' if args.metric == 'latency' else 'throughput'
+    series = {}
+    for (window, length), rows in entries.iteritems():
+        # Skip warmup rounds and the last one, as for the logs
+        last = max(int(row['round']) for row in rows)
+        rows = [row for row in rows if args.warmup_rounds <= int(row['round']) < last] or rows
+
+        avgv = np.mean([float(row[metric + '_mean']) for row in rows])
+        minv = min(float(row[metric + '_min']) for row in rows)
+        maxv = max(float(row[metric + '_max']) for row in rows)
+        stdev = np.mean([float(row[metric + '_stdev']) for row in rows])
+
+        if args.x_axis == 'window':
+            line, x = length, window
+        else:
+            line, x = window, length
+        if line not in series:
+            series[line] = {}
+        series[line][x] = (minv, avgv, maxv, stdev)
+
+    name = os.path.basename(summary.name).split('.')[0]
+    xs = []
+    for line, data in sorted(series.iteritems()):
+        points = sorted(data.iteritems())
+        np_x = np.array([x for x, _ in points])
+        np_min = np.array([item[0] for _, item in points])
+        np_avg = np.array([item[1] for _, item in points])
+        np_max = np.array([item[2] for _, item in points])
+        np_std = np.array([item[3] for _, item in points])
+        xs.extend(np_x)
+
+        label = name
+        if len(series) > 1 or args.x_axis == 'window':
+            label = '%s (%s = %d)' % (name, 'window' if args.x_axis == 'length' else 'length', line)
+        if 'errorbar' in args.stats:
+            plt.errorbar(np_x, np_avg, np_std, label='%s - errorbar' % label, marker='.', linewidth=0.75)
+        if 'avg' in args.stats:
+            plt.plot(np_x, np_avg, label='%s - avg' % label, marker='.', linewidth=0.75)
+        if 'min' in args.stats:
+            plt.plot(np_x, np_min, label='%s - min' % label, marker=".", linewidth=0.75)
+        if 'max' in args.stats:
+            plt.plot(np_x, np_max, label='%s - max' % label, marker=".", linewidth=0.75)
+
+    return (min(xs), max(xs))
 
 def plot_rdma_logfile(logfile):
     data = {}
@@ -166,17 +226,24 @@ def plot_rdma_logfile(logfile):
 if args.mpi_logs:
     for logfile in args.mpi_logs:
         plot_mpi_logfile(logfile)
+if args.mpi_summaries:
+    for summary in args.mpi_summaries:
+        plot_mpi_summary(summary)
 if args.rdma_logs:
     for logfile in args.rdma_logs:
         plot_rdma_logfile(logfile)
 
-plt.xlabel('Message size per node (bytes)')
+if args.x_axis == 'window':
+    plt.xlabel('In-flight MPI operations per rank (window)')
+else:
+    plt.xlabel('Message size per node (bytes)')
 plt.xscale('log', basex=2)
 #if args.metric == 'latency':
 #    plt.yscale('log', basey=10)
 
 #plt.xlim(min(np_x), max(np_x))
-plt.xlim(1, pow(2, 18))
+if args.x_axis == 'length' and not args.mpi_summaries:  # Summaries hold actual lengths
+    plt.xlim(1, pow(2, 18))
 if args.metric == 'latency':
     plt.ylabel('Latency (usec)')
     plt.ylim(0, 40)
@@ -0,0 +1,35 @@
+#!/usr/bin/env bash
+
+# Check if MPI environment is loaded
+if ! [ -x "$(command -v mpirun)" ]; then
+    source ./setup-hpcx.sh
+fi
+
+# Config
+execname=../build/rotor_exec
+hostfile=hosts.config
+hosts=$(cat $hostfile| paste -s -d "," -)
+np=$(cat $hostfile | wc -l)
+
+# MPI only starts the ranks and gathers results, slots go over the transport's writes
+FLAGS+="--allow-run-as-root -bind-to none "
+
+# Executable flags, rlb_v1's defaults: 1000 slots of 300µsec and 1 MB
+length=1048576
+#length="1024:1048576:2"  # or a --length-range sweep
+count=1000
+warmup=1
+slot_us=300
+port=1234       # rank r listens on port + r
+pin="compact"
+transport=verbs # or mpi, shm (one host) or tcp
+
+# Launch MPI job
+set -x
+if [[ $length == *:* ]]; then
+    lengthflags="--length-range=$length"
+else
+    lengthflags="-b $length"
+fi
+execflags="$lengthflags -r $count -w $warmup --pacing=slot:$slot_us -p $port --pin=$pin --transport=$transport"
+mpirun -np $np --host $hosts $FLAGS $execname $execflags
@@ -8,18 +8,33 @@ l=1
 limit=8388608
 
 count=1000
-verb="write"
-mode="throughput"
+verbs="write"   # e.g. "read write send": one-sided against two-sided at the same sizes,
+                # or "write-imm write-send": notified writes, immediate against a trailing send
+modes="throughput"  # e.g. "latency throughput"
 warmup=0
 mr_count=1
+depths="512"    # e.g. "1 4 16 64 256 512": outstanding requests, at most MAX_WR
+signal=64       # signal every k-th request, at most the depth
+post_batch=16   # requests chained per doorbell (ibv_post_send)
+inlines="256"   # e.g. "0 256" in latency mode: 2 B - 256 B with and without inline sends
+threads=1       # client threads, each on its own core
+qps=1           # QPs per thread; the server must use the same threads and qps
+clients=1       # clients the server waits for, each with one connection when more than one
+srq=""          # "--srq": the server receives through one SRQ and CQ for all clients
+completions="poll"  # e.g. "poll event adaptive:20": latency vs. CPU of each completion mode
 
 server="$1"
 
+# One connection and one set of MRs for all lengths
 cd ../build
-while [[ $l -le $limit ]]; do
-    echo "Length = $l ..."
-    ./rdma_exec -b $l -r $count -v $verb -m $mode -w $warmup --mr_count=$mr_count $server
-    (( l *= 2 ))
-    echo ""
+for mode in $modes; do
+    for verb in $verbs; do
+        for completion in $completions; do
+            for inline in $inlines; do
+                for depth in $depths; do
+                    ./rdma_exec --length-range=$l:$limit:2 -r $count -v $verb -m $mode -w $warmup --mr_count=$mr_count --depth=$depth --signal=$(( signal < depth ? signal : depth )) --post-batch=$post_batch --inline=$inline --completion=$completion --threads=$threads --qps=$qps --clients=$clients $srq $server
+                done
+            done
+        done
+    done
 done
-
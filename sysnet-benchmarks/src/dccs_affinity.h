@@ -0,0 +1,398 @@
+/**
+ * CPU pinning for DC circuit switch.
+ *
+ * Reads the CPU topology from sysfs and picks a logical CPU for each local
+ * rank, so that ranks sharing a host land on distinct physical cores, close
+ * to the NIC where possible. Policies:
+ *  - compact:   fill the cores of the NIC's NUMA node first, then the rest;
+ *  - scatter:   round-robin over NUMA nodes, starting with the NIC's;
+ *  - list:<cpus> take CPUs from an explicit list such as "list:0,2,4-7";
+ *  - none:      leave the affinity set by the launcher alone.
+ * Hyperthread siblings are only used once every physical core has a rank.
+ * Only the CPUs the process is allowed to run on, under a cpuset or the
+ * launcher's mask, are candidates, listed ones included.
+ *
+ * Self-contained so that the C++ rotor tests can include it as well; the
+ * local rank helper is available when <mpi.h> is included first.
+ */
+
+#ifndef DCCS_AFFINITY_H
+#define DCCS_AFFINITY_H
+
+#include <dirent.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define AFFINITY_SYSFS_CPU "/sys/devices/system/cpu"
+#define AFFINITY_SYSFS_IB "/sys/class/infiniband"
+#define AFFINITY_PATH_LENGTH 512   // Room for a full d_name
+#define AFFINITY_KEYS 7
+
+typedef enum { PIN_NONE, PIN_COMPACT, PIN_SCATTER, PIN_LIST } PinPolicy;
+
+struct dccs_cpu {
+    int cpu;        // Logical CPU
+    int core;       // core_id within the package
+    int package;    // physical_package_id
+    int node;       // NUMA node, -1 if unknown
+    int key[AFFINITY_KEYS];     // Placement order under the current policy
+};
+
+struct dccs_binding {
+    PinPolicy policy;
+    int local_rank;
+    int cpu;        // Pinned CPU, -1 when unpinned
+    int core;
+    int package;
+    int node;
+    int nic_node;   // NUMA node of the NIC, -1 if unknown
+    bool shared;    // Another local rank was given the same physical core
+};
+
+/**
+ * Parse a Linux cpulist such as "0-3,8,10-11". Returns the number of CPUs
+ * stored in cpus (at most max), or -1 on a malformed list.
+ */
+static inline int affinity_parse_cpulist(const char *list, int *cpus, int max) {
+    int count = 0;
+    const char *p = list;
+
+    while (*p != '\0' && *p != '\n') {
+        char *end;
+        long first = strtol(p, &end, 10), last;
+        if (end == p || first < 0)
+            return -1;
+        last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first)
+                return -1;
+        }
+        for (long cpu = first; cpu <= last && count < max; cpu++)
+            cpus[count++] = (int)cpu;
+        if (*end == ',')
+            end++;
+        else if (*end != '\0' && *end != '\n')
+            return -1;
+        p = end;
+    }
+
+    return count;
+}
+
+static inline int affinity_read_int(const char *path, int *value) {
+    FILE *file = fopen(path, "r");
+    int rv;
+
+    if (file == NULL)
+        return -1;
+    rv = fscanf(file, "%d", value) == 1 ? 0 : -1;
+    fclose(file);
+
+    return rv;
+}
+
+/**
+ * NUMA node of the given CPU, read from its nodeN link, or -1 without NUMA.
+ */
+static inline int affinity_cpu_node(int cpu) {
+    char path[AFFINITY_PATH_LENGTH];
+    struct dirent *entry;
+    DIR *dir;
+    int node = -1;
+
+    snprintf(path, sizeof(path), AFFINITY_SYSFS_CPU "/cpu%d", cpu);
+    if ((dir = opendir(path)) == NULL)
+        return -1;
+    while ((entry = readdir(dir)) != NULL)
+        if (sscanf(entry->d_name, "node%d", &node) == 1)
+            break;
+    closedir(dir);
+
+    return node;
+}
+
+/**
+ * NUMA node of an RDMA device, or of the first one when device is NULL.
+ * Returns -1 when there is no device or the platform does not report it.
+ */
+static inline int affinity_nic_node(const char *device) {
+    char path[AFFINITY_PATH_LENGTH];
+    int node = -1;
+
+    if (device == NULL) {
+        struct dirent *entry;
+        DIR *dir = opendir(AFFINITY_SYSFS_IB);
+        if (dir == NULL)
+            return -1;
+        path[0] = '\0';
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] == '.')
+                continue;
+            snprintf(path, sizeof(path), AFFINITY_SYSFS_IB "/%s/device/numa_node", entry->d_name);
+            break;
+        }
+        closedir(dir);
+        if (path[0] == '\0')
+            return -1;
+    } else {
+        snprintf(path, sizeof(path), AFFINITY_SYSFS_IB "/%s/device/numa_node", device);
+    }
+
+    if (affinity_read_int(path, &node) != 0)
+        return -1;
+
+    return node;
+}
+
+/**
+ * Load the online CPUs the process may run on. Returns the CPU count and a
+ * malloc'ed array in cpus, or -1 if the topology cannot be read or no CPU
+ * is allowed.
+ */
+static inline int affinity_load_topology(struct dccs_cpu **cpus) {
+    char path[AFFINITY_PATH_LENGTH], online[4096];
+    int ids[CPU_SETSIZE];
+    int count, allowed_count = 0;
+    cpu_set_t allowed;
+    FILE *file;
+
+    if ((file = fopen(AFFINITY_SYSFS_CPU "/online", "r")) == NULL)
+        return -1;
+    if (fgets(online, sizeof(online), file) == NULL) {
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+
+    if ((count = affinity_parse_cpulist(online, ids, CPU_SETSIZE)) <= 0)
+        return -1;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return -1;
+    for (int i = 0; i < count; i++)
+        if (ids[i] < CPU_SETSIZE && CPU_ISSET((size_t)ids[i], &allowed))
+            ids[allowed_count++] = ids[i];
+    if ((count = allowed_count) == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if ((*cpus = (struct dccs_cpu *)calloc((size_t)count, sizeof(struct dccs_cpu))) == NULL)
+        return -1;
+
+    for (int i = 0; i < count; i++) {
+        struct dccs_cpu *cpu = *cpus + i;
+        cpu->cpu = ids[i];
+        snprintf(path, sizeof(path), AFFINITY_SYSFS_CPU "/cpu%d/topology/core_id", ids[i]);
+        if (affinity_read_int(path, &cpu->core) != 0)
+            cpu->core = ids[i];
+        snprintf(path, sizeof(path), AFFINITY_SYSFS_CPU "/cpu%d/topology/physical_package_id", ids[i]);
+        if (affinity_read_int(path, &cpu->package) != 0)
+            cpu->package = 0;
+        cpu->node = affinity_cpu_node(ids[i]);
+    }
+
+    return count;
+}
+
+static inline int affinity_compare_keys(const void *a, const void *b) {
+    const struct dccs_cpu *x = (const struct dccs_cpu *)a, *y = (const struct dccs_cpu *)b;
+
+    for (int k = 0; k < AFFINITY_KEYS; k++)
+        if (x->key[k] != y->key[k])
+            return x->key[k] < y->key[k] ? -1 : 1;
+
+    return 0;
+}
+
+static inline bool affinity_same_core(const struct dccs_cpu *x, const struct dccs_cpu *y) {
+    return x->package == y->package && x->core == y->core;
+}
+
+static inline bool affinity_core_before(const struct dccs_cpu *x, const struct dccs_cpu *y) {
+    if (x->package != y->package)
+        return x->package < y->package;
+    if (x->core != y->core)
+        return x->core < y->core;
+    return x->cpu < y->cpu;
+}
+
+/**
+ * Sort cpus into placement order for compact or scatter. Each CPU is keyed
+ * by its hyperthread index on its core first, so the first cores returned
+ * are all distinct physical cores.
+ */
+static inline void affinity_order(struct dccs_cpu *cpus, int count, PinPolicy policy, int nic_node) {
+    for (int i = 0; i < count; i++) {
+        int thread = 0;
+        for (int j = 0; j < count; j++)
+            if (affinity_same_core(cpus + j, cpus + i) && cpus[j].cpu < cpus[i].cpu)
+                thread++;
+        cpus[i].key[0] = thread;
+    }
+
+    for (int i = 0; i < count; i++) {
+        struct dccs_cpu *cpu = cpus + i;
+        int node_index = 0;
+
+        // Scatter: position among the physical cores of its node, so nodes take turns
+        if (policy == PIN_SCATTER)
+            for (int j = 0; j < count; j++)
+                if (cpus[j].key[0] == 0 && cpus[j].node == cpu->node &&
+                        !affinity_same_core(cpus + j, cpu) && affinity_core_before(cpus + j, cpu))
+                    node_index++;
+
+        cpu->key[1] = node_index;
+        cpu->key[2] = nic_node >= 0 && cpu->node != nic_node;
+        cpu->key[3] = cpu->node;
+        cpu->key[4] = cpu->package;
+        cpu->key[5] = cpu->core;
+        cpu->key[6] = cpu->cpu;
+    }
+
+    qsort(cpus, (size_t)count, sizeof(struct dccs_cpu), affinity_compare_keys);
+}
+
+/**
+ * Parse a --pin value. Returns 0 and the policy, with the CPU list of
+ * "list:" policies in list (NULL otherwise), or -1 if it is invalid.
+ */
+static inline int affinity_parse_policy(const char *spec, PinPolicy *policy, const char **list) {
+    int cpus[CPU_SETSIZE];
+
+    *list = NULL;
+    if (strcmp(spec, "none") == 0) {
+        *policy = PIN_NONE;
+    } else if (strcmp(spec, "compact") == 0) {
+        *policy = PIN_COMPACT;
+    } else if (strcmp(spec, "scatter") == 0) {
+        *policy = PIN_SCATTER;
+    } else if (strncmp(spec, "list:", 5) == 0) {
+        *policy = PIN_LIST;
+        *list = spec + 5;
+        if (affinity_parse_cpulist(*list, cpus, CPU_SETSIZE) <= 0)
+            return -1;
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+static inline const char *affinity_policy_name(PinPolicy policy) {
+    switch (policy) {
+        case PIN_NONE:
+            return "none";
+        case PIN_COMPACT:
+            return "compact";
+        case PIN_SCATTER:
+            return "scatter";
+        case PIN_LIST:
+            return "list";
+    }
+
+    return "unknown";
+}
+
+/**
+ * Pin the calling process for the given local rank (its index among the
+ * ranks on this host) under the --pin policy spec. nic names the RDMA
+ * device to stay close to, NULL for the first one. Fills in binding and
+ * returns 0, or -1 with errno set if the CPU could not be chosen or set.
+ */
+static inline int affinity_pin(const char *spec, const char *nic, int local_rank, struct dccs_binding *binding) {
+    struct dccs_cpu *cpus = NULL;
+    const char *list;
+    int count, index, rv = -1;
+    cpu_set_t set;
+
+    memset(binding, 0, sizeof(struct dccs_binding));
+    binding->local_rank = local_rank;
+    binding->cpu = binding->core = binding->package = binding->node = -1;
+    binding->nic_node = affinity_nic_node(nic);
+
+    if (affinity_parse_policy(spec, &binding->policy, &list) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (binding->policy == PIN_NONE)
+        return 0;
+
+    if ((count = affinity_load_topology(&cpus)) <= 0) {
+        errno = errno != 0 ? errno : ENOENT;
+        return -1;
+    }
+
+    if (binding->policy == PIN_LIST) {
+        int listed[CPU_SETSIZE];
+        int n = affinity_parse_cpulist(list, listed, CPU_SETSIZE);
+        binding->cpu = listed[local_rank % n];
+        binding->shared = local_rank >= n;
+        // Offline, or outside the mask we may run on
+        for (index = 0; index < count; index++)
+            if (cpus[index].cpu == binding->cpu)
+                break;
+        if (index == count) {
+            errno = EINVAL;
+            goto out;
+        }
+    } else {
+        int cores = 0;
+        affinity_order(cpus, count, binding->policy, binding->nic_node);
+        while (cores < count && cpus[cores].key[0] == 0)
+            cores++;
+        index = local_rank % count;
+        binding->cpu = cpus[index].cpu;
+        binding->shared = local_rank >= cores;
+    }
+    binding->core = cpus[index].core;
+    binding->package = cpus[index].package;
+    binding->node = cpus[index].node;
+
+    CPU_ZERO(&set);
+    CPU_SET((size_t)binding->cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) == 0)
+        rv = 0;
+
+out:
+    free(cpus);
+    return rv;
+}
+
+/**
+ * Describe a binding for the per-rank report.
+ */
+static inline void affinity_describe(const struct dccs_binding *binding, char *buf, size_t size) {
+    if (binding->policy == PIN_NONE) {
+        snprintf(buf, size, "local rank = %d, policy = none, NIC node = %d",
+                binding->local_rank, binding->nic_node);
+        return;
+    }
+
+    snprintf(buf, size, "local rank = %d, policy = %s, cpu = %d, core = %d, package = %d, node = %d, NIC node = %d%s",
+            binding->local_rank, affinity_policy_name(binding->policy), binding->cpu, binding->core,
+            binding->package, binding->node, binding->nic_node,
+            binding->shared ? ", core shared with another local rank" : "");
+}
+
+#ifdef MPI_VERSION
+/**
+ * Index of the calling rank among the ranks sharing its host.
+ */
+static inline int affinity_local_rank(MPI_Comm comm) {
+    MPI_Comm local;
+    int local_rank;
+
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &local);
+    MPI_Comm_rank(local, &local_rank);
+    MPI_Comm_free(&local);
+
+    return local_rank;
+}
+#endif
+
+#endif // DCCS_AFFINITY_H
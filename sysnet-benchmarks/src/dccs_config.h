@@ -15,26 +15,65 @@
 // #define CPU_CLOCK_RATE 2400000000   // 2.4 GHz
 #define CACHE_LINE_SIZE 64
 #define USE_RDTSC 0
-#define CPU_TO_USE 0
+#define HELPER_THREADS 16       // Max threads filling or checksumming a buffer
+#define HELPER_THREAD_BYTES (16UL * 1024 * 1024)   // Min bytes per helper thread
+#define CHECKSUM_CHUNK_BYTES (1024 * 1024)  // Max bytes per verified chunk, at most one message
+#define CHECKSUM_REPORT_LIMIT 10    // Mismatching chunks logged per rank
 
 /* RDMA configuration */
-#define MAX_WR 1000
+#define MAX_WR 1000             // Send and receive queue capacity of a QP
+#define CQ_POLL_BATCH 32        // Completions reaped per ibv_poll_cq
+#define MR_CACHE_SIZE 8         // Control message registrations kept for reuse
+#define SRQ_SIZE MAX_WR         // Receive WRs of a server's SRQ and shared CQ
+#define RECV_RING_SIZE 256      // Receive buffers per receive queue for Send, at most SRQ_SIZE
+#define RECV_RING_BYTES (64UL * 1024 * 1024)    // Max bytes of receive buffers per receive queue
+#define RECV_REPOST_BATCH 32    // Receive buffers reposted per doorbell
+#define RECV_NOTIFY_LENGTH 64   // Receive buffer bytes for the notifications of one-sided writes
+#define ROTOR_RECV_DEPTH 64     // Write notifications kept posted per peer of a rotor
+
+/* Transport configuration */
+#define TRANSPORT_MAX_BUFFERS 8     // Registered buffers per transport
+#define TRANSPORT_QUEUE_DEPTH MAX_WR    // Sends and writes, and receives, outstanding per peer
+#define TRANSPORT_SHM_RING_BYTES (256UL * 1024)    // Bytes of the shared-memory ring from one rank to another
 
 /* Protocol default values */
 #define DEFAULT_MESSAGE_COUNT 1000
 #define DEFAULT_MESSAGE_LENGTH 2
+#define DEFAULT_LENGTH_FACTOR 2
 #define DEFAULT_PORT "1234"
 #define DEFAULT_WARMUP_COUNT 0
 #define DEFAULT_MR_COUNT 1
+#define DEFAULT_DEPTH 512       // At most MAX_WR
+#define DEFAULT_SIGNAL_INTERVAL 64
+#define DEFAULT_POST_BATCH 16   // Work requests per doorbell
+#define DEFAULT_THREADS 1
+#define DEFAULT_QPS 1           // Per thread
+#define DEFAULT_CLIENTS 1       // Served by an RDMA server
+#define DEFAULT_MAX_INLINE 256  // Inline data size asked of a QP, in bytes
+#define DEFAULT_COMPLETION COMPLETION_POLL
+#define DEFAULT_POLL_BUDGET 20  // Adaptive completion busy-poll time, in µsec
 #define DEFAULT_REPEAT_COUNT 1
 #define DEFAULT_DIRECTION DIR_OUT
+#define DEFAULT_WINDOW 64       // MPI operations in flight per rank
+#define DEFAULT_TIMING TIMING_LOCAL
+#define DEFAULT_SCHEDULE SCHEDULE_ALL
+#define DEFAULT_PACING PACING_COMPLETION
+#define DEFAULT_FORMAT FORMAT_CSV
+#define DEFAULT_SEED 1
+#define DEFAULT_PIN "compact"     // CPU pinning policy, see dccs_affinity.h
+#define DEFAULT_ROTOR_SLOT_US 300   // Rotor slot without --pacing slot:<µsec>, as in rlb_v1
+#define DEFAULT_TRANSPORT TRANSPORT_VERBS
 
 /* Protocol configuration */
 #define DCCS_CYCLE_UPTIME 180   // Cycle up time, in µsec
 #define DCCS_CYCLE_DOWNTIME 20  // Cycle down time, in µsec
+#define SYNC_START_MESSAGE "Go"
+#define SYNC_START_MESSAGE_LENGTH 3
 #define SYNC_END_MESSAGE "End"
 #define SYNC_END_MESSAGE_LENGTH 4
-#define MPI_FIRE_AND_FORGET 1
+#define MPI_FIRE_AND_FORGET 0   // 1 frees local-timing sends untracked, unbounded by --window
+#define CLOCK_SYNC_ROUNDS 100   // Ping-pongs per rank to estimate its offset from rank 0
+#define EPOCH_START_DELAY 1000  // Time from announcing the common epoch to reaching it, in µsec
 
 /* Math constants */
 #define MILLION 1000000UL
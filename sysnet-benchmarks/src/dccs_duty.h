@@ -0,0 +1,240 @@
+/**
+ * Duty-cycled sender for DC circuit switch
+ */
+
+#ifndef DCCS_DUTY_H
+#define DCCS_DUTY_H
+
+#include "dccs_rotor.h"
+#include "dccs_transport.h"
+
+/**
+ * What happened in one duty cycle, to the writes posted in its up time.
+ * A write that lands after the up time it was posted in would have been
+ * cut by the reconfiguration: it is stranded.
+ */
+struct dccs_duty_cycle {
+    uint64_t posted;        // Writes we posted
+    uint64_t delivered;     // Writes delivered to us in time
+    uint64_t bytes;         // Their bytes
+    uint64_t stranded;      // Writes delivered to us too late
+};
+
+/**
+ * A rank of a duty-cycled circuit: in each cycle it writes to one peer
+ * for as long as the circuit is up, at most depth writes in flight, and
+ * posts nothing while it is down. Writes carry their cycle as the
+ * immediate, so the receiver can tell whether they made it in time.
+ */
+struct dccs_duty {
+    struct dccs_transport *transport;
+    int size;
+    int rank;
+    size_t length;                  // Bytes per buffer, the largest length
+    size_t depth;                   // Writes in flight to a peer, receives posted for one
+    uint8_t *send_buf;
+    int send_handle;
+    uint8_t *recv_bufs;             // Buffer of peer p at p * length
+    int recv_handle;
+    size_t *outstanding;            // Per peer, writes not yet completed
+    uint64_t *sent;                 // Per peer, writes of the run
+    uint64_t *received;             // Per peer, writes of the run delivered to us
+    struct dccs_duty_cycle *cycles;
+    size_t cycle_count;
+    uint64_t start;                 // Of the run, on our clock
+    uint64_t up_cycles;             // Clock cycles a circuit is up,
+    uint64_t period_cycles;         // and of a whole duty cycle
+};
+
+static inline int duty_dest(struct dccs_duty *duty, struct dccs_parameters *params, size_t cycle) {
+    return rotor_dest(duty->size, duty->rank, params->rotate ? cycle : 0);
+}
+
+/**
+ * Set up the buffers for writes of up to params->length_max bytes, and
+ * the receives every peer's notifications take. Collective.
+ */
+int duty_init(struct dccs_duty *duty, struct dccs_transport *transport, struct dccs_parameters *params) {
+    memset(duty, 0, sizeof(struct dccs_duty));
+    duty->transport = transport;
+    duty->size = transport->size;
+    duty->rank = transport->rank;
+    duty->send_handle = duty->recv_handle = -1;
+    duty->length = params->length_max;
+    duty->depth = params->window;
+    duty->outstanding = calloc((size_t)duty->size, sizeof(size_t));
+    duty->sent = calloc((size_t)duty->size, sizeof(uint64_t));
+    duty->received = calloc((size_t)duty->size, sizeof(uint64_t));
+    duty->send_buf = malloc_payload(duty->length, params->seed, (uint64_t)duty->rank, 0);
+    duty->recv_bufs = calloc((size_t)duty->size, duty->length);
+    if (duty->outstanding == NULL || duty->sent == NULL || duty->received == NULL || duty->send_buf == NULL || duty->recv_bufs == NULL) {
+        log_error("Failed to allocate a duty-cycled sender of %d ranks and %zu B writes.\n", duty->size, duty->length);
+        return -1;
+    }
+
+    if ((duty->send_handle = transport_reg(transport, duty->send_buf, duty->length)) < 0)
+        return -1;
+    if ((duty->recv_handle = transport_reg(transport, duty->recv_bufs, (size_t)duty->size * duty->length)) < 0)
+        return -1;
+
+    // Every peer keeps its receives posted, whether it is matched with us or not
+    for (int peer = 0; peer < duty->size; peer++) {
+        for (size_t i = 0; peer != duty->rank && i < duty->depth; i++) {
+            if (transport_post_recv(transport, peer, duty->recv_handle, 0, 0, (uint64_t)peer) != 0)
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Reap what completed once: our writes, and the writes delivered to us,
+ * in time or stranded depending on when their cycle's up time ended. With
+ * no down time, the circuit never goes away and nothing is stranded.
+ */
+int duty_poll(struct dccs_duty *duty) {
+    struct dccs_completion comps[CQ_POLL_BATCH];
+    int polled = transport_poll(duty->transport, comps, CQ_POLL_BATCH);
+    uint64_t now = get_cycles();
+
+    if (polled < 0)
+        return -1;
+
+    for (int i = 0; i < polled; i++) {
+        struct dccs_completion *comp = comps + i;
+        if (comp->op == TRANSPORT_OP_WRITE) {
+            duty->outstanding[comp->peer]--;
+            continue;
+        }
+        if (comp->op != TRANSPORT_OP_NOTIFY || comp->imm >= duty->cycle_count) {
+            log_error("Unexpected completion %d of cycle %u from rank %d.\n", comp->op, comp->imm, comp->peer);
+            return -1;
+        }
+
+        struct dccs_duty_cycle *cycle = duty->cycles + comp->imm;
+        uint64_t up_end = duty->start + comp->imm * duty->period_cycles + duty->up_cycles;
+        if (now <= up_end || duty->up_cycles == duty->period_cycles) {
+            cycle->delivered++;
+            cycle->bytes += comp->length;
+        } else {
+            cycle->stranded++;
+        }
+        duty->received[comp->peer]++;
+        if (transport_post_recv(duty->transport, comp->peer, duty->recv_handle, 0, 0, (uint64_t)comp->peer) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Run cycles duty cycles of uptime_us up and downtime_us down from start
+ * on our clock, writing params->length bytes at a time. Writes are only
+ * posted while the circuit is up; while it is down, we keep reaping what
+ * is in flight. Collective: at the end, every rank waits for all the
+ * writes owed to it.
+ */
+int duty_run(struct dccs_duty *duty, struct dccs_parameters *params, uint64_t start, size_t cycles, size_t uptime_us, size_t downtime_us) {
+    uint64_t *expected;
+    MPI_Request request;
+    int rv = -1;
+
+    free(duty->cycles);
+    duty->cycles = calloc(cycles, sizeof(struct dccs_duty_cycle));
+    expected = calloc((size_t)duty->size, sizeof(uint64_t));
+    if (duty->cycles == NULL || expected == NULL) {
+        log_error("Failed to allocate a run of %zu cycles.\n", cycles);
+        goto out;
+    }
+    duty->cycle_count = cycles;
+    duty->start = start;
+    duty->up_cycles = uptime_us * clock_rate / MILLION;
+    duty->period_cycles = (uptime_us + downtime_us) * clock_rate / MILLION;
+    memset(duty->sent, 0, (size_t)duty->size * sizeof(uint64_t));
+    memset(duty->received, 0, (size_t)duty->size * sizeof(uint64_t));
+
+    for (size_t c = 0; c < cycles; c++) {
+        int dest = duty_dest(duty, params, c);
+        uint64_t up_start = start + c * duty->period_cycles, up_end = up_start + duty->up_cycles;
+
+        // The previous cycle's down time, or the wait for the first
+        while (get_cycles() < up_start) {
+            if (duty_poll(duty) != 0)
+                goto out;
+        }
+
+        while (get_cycles() < up_end) {
+            if (duty->outstanding[dest] < duty->depth) {
+                if (transport_post_write(duty->transport, dest, duty->send_handle, 0, params->length,
+                        duty->recv_handle, (size_t)duty->rank * duty->length, (uint32_t)c, c) != 0) {
+                    log_error("Failed to post a write of cycle %zu to rank %d.\n", c, dest);
+                    goto out;
+                }
+                duty->outstanding[dest]++;
+                duty->sent[dest]++;
+                duty->cycles[c].posted++;
+            }
+            if (duty_poll(duty) != 0)
+                goto out;
+        }
+    }
+
+    // Peers may need us to take in their last writes before theirs complete
+    MPI_Ialltoall(duty->sent, 1, MPI_UINT64_T, expected, 1, MPI_UINT64_T, MPI_COMM_WORLD, &request);
+    for (int done = 0; !done; MPI_Test(&request, &done, MPI_STATUS_IGNORE)) {
+        if (duty_poll(duty) != 0)
+            goto out;
+    }
+    for (int peer = 0; peer < duty->size; peer++) {
+        while (duty->outstanding[peer] > 0 || duty->received[peer] < expected[peer]) {
+            if (duty_poll(duty) != 0)
+                goto out;
+        }
+    }
+    rv = 0;
+
+out:
+    free(expected);
+    return rv;
+}
+
+/**
+ * Check the buffer of every peer that wrote to us in the last run against
+ * what it writes. Returns the number of mismatching peers.
+ */
+size_t duty_verify(struct dccs_duty *duty, struct dccs_parameters *params) {
+    size_t bad = 0;
+
+    for (int peer = 0; peer < duty->size; peer++) {
+        if (peer == duty->rank || duty->received[peer] == 0)
+            continue;
+
+        size_t mismatch = verify_payload(duty->recv_bufs + (size_t)peer * duty->length, params->length, params->seed, (uint64_t)peer, 0);
+        if (mismatch != params->length) {
+            log_error("rank = %d, buffer of rank %d mismatches at byte %zu of %zu.\n", duty->rank, peer, mismatch, params->length);
+            bad++;
+        }
+    }
+
+    return bad;
+}
+
+/**
+ * Release the buffers. Collective, like duty_init().
+ */
+void duty_destroy(struct dccs_duty *duty) {
+    if (duty->transport != NULL) {
+        transport_dereg(duty->transport, duty->send_handle);
+        transport_dereg(duty->transport, duty->recv_handle);
+    }
+    free(duty->send_buf);
+    free(duty->recv_bufs);
+    free(duty->outstanding);
+    free(duty->sent);
+    free(duty->received);
+    free(duty->cycles);
+    memset(duty, 0, sizeof(struct dccs_duty));
+}
+
+#endif // DCCS_DUTY_H
@@ -0,0 +1,229 @@
+/**
+ * MPI helpers for DC circuit switch
+ */
+
+#ifndef DCCS_MPI_H
+#define DCCS_MPI_H
+
+#include <limits.h>
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "dccs_utils.h"
+
+/* Request pool */
+
+/**
+ * A fixed window of in-flight nonblocking operations. Slots are handed out
+ * by request_pool_get(), and completed slots are recycled with MPI_Testsome.
+ */
+struct dccs_request_pool {
+    MPI_Request *requests;  // window slots, MPI_REQUEST_NULL when free
+    int *indices;           // MPI_Testsome output
+    int *free_slots;        // stack of free slot indices
+    int window;
+    int free_count;
+    size_t completed;       // operations completed since init
+    uint64_t last_completion;   // get_cycles() when a completion was last observed
+};
+
+int request_pool_init(struct dccs_request_pool *pool, size_t window) {
+    memset(pool, 0, sizeof(struct dccs_request_pool));
+    if (window == 0 || window > INT_MAX) {
+        log_error("Invalid request window %zu.\n", window);
+        return -1;
+    }
+
+    pool->window = (int)window;
+    pool->requests = malloc(window * sizeof(MPI_Request));
+    pool->indices = malloc(window * sizeof(int));
+    pool->free_slots = malloc(window * sizeof(int));
+    if (pool->requests == NULL || pool->indices == NULL || pool->free_slots == NULL) {
+        log_error("Failed to allocate a request pool of %zu.\n", window);
+        free(pool->requests);
+        free(pool->indices);
+        free(pool->free_slots);
+        return -1;
+    }
+
+    for (int i = 0; i < pool->window; i++) {
+        pool->requests[i] = MPI_REQUEST_NULL;
+        pool->free_slots[i] = pool->window - 1 - i;
+    }
+    pool->free_count = pool->window;
+
+    return 0;
+}
+
+void request_pool_destroy(struct dccs_request_pool *pool) {
+    free(pool->requests);
+    free(pool->indices);
+    free(pool->free_slots);
+    memset(pool, 0, sizeof(struct dccs_request_pool));
+}
+
+static inline int request_pool_in_flight(struct dccs_request_pool *pool) {
+    return pool->window - pool->free_count;
+}
+
+static inline bool request_pool_full(struct dccs_request_pool *pool) {
+    return pool->free_count == 0;
+}
+
+/**
+ * Test all in-flight operations once and recycle the completed slots.
+ * Returns the number of operations that completed.
+ */
+int request_pool_progress(struct dccs_request_pool *pool) {
+    int outcount;
+
+    if (pool->free_count == pool->window)
+        return 0;
+
+    MPI_Testsome(pool->window, pool->requests, &outcount, pool->indices, MPI_STATUSES_IGNORE);
+    if (outcount == MPI_UNDEFINED)
+        return 0;
+
+    for (int i = 0; i < outcount; i++)
+        pool->free_slots[pool->free_count++] = pool->indices[i];
+    pool->completed += (size_t)outcount;
+    if (outcount > 0)
+        pool->last_completion = get_cycles();
+
+    return outcount;
+}
+
+/**
+ * Get a free slot to post an operation into, making progress on the window
+ * until one frees up.
+ */
+MPI_Request *request_pool_get(struct dccs_request_pool *pool) {
+    while (pool->free_count == 0)
+        request_pool_progress(pool);
+
+    return pool->requests + pool->free_slots[--pool->free_count];
+}
+
+/**
+ * Wait until every posted operation has completed.
+ */
+void request_pool_drain(struct dccs_request_pool *pool) {
+    while (pool->free_count < pool->window)
+        request_pool_progress(pool);
+}
+
+/* Clock synchronization */
+
+/**
+ * Estimate the offset to add to our get_cycles() to get rank 0's. Each rank
+ * ping-pongs rank 0 CLOCK_SYNC_ROUNDS times and keeps the sample with the
+ * shortest round trip, assuming rank 0 stamped it halfway through.
+ */
+int64_t sync_clock_offset(int size, int rank) {
+    int64_t offset = 0;
+    uint64_t remote, ping = 0;
+
+    for (int peer = 1; peer < size; peer++) {
+        if (rank == 0) {
+            for (int i = 0; i < CLOCK_SYNC_ROUNDS; i++) {
+                MPI_Recv(&ping, 1, MPI_UINT64_T, peer, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                remote = get_cycles();
+                MPI_Send(&remote, 1, MPI_UINT64_T, peer, 0, MPI_COMM_WORLD);
+            }
+        } else if (rank == peer) {
+            uint64_t best_rtt = UINT64_MAX;
+            for (int i = 0; i < CLOCK_SYNC_ROUNDS; i++) {
+                uint64_t start = get_cycles();
+                MPI_Send(&ping, 1, MPI_UINT64_T, 0, 0, MPI_COMM_WORLD);
+                MPI_Recv(&remote, 1, MPI_UINT64_T, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                uint64_t end = get_cycles();
+                if (end - start < best_rtt) {
+                    best_rtt = end - start;
+                    offset = (int64_t)remote - (int64_t)(start + best_rtt / 2);
+                }
+            }
+
+            log_debug("rank = %d, clock offset = %ld, round trip = %.3fµsec.\n", rank, offset, (double)best_rtt / (double)clock_rate * 1e6);
+        }
+    }
+
+    return offset;
+}
+
+/**
+ * Agree on a common start time EPOCH_START_DELAY from now on rank 0's
+ * clock, and spin until it is reached. Returns the epoch on rank 0's clock.
+ */
+uint64_t wait_for_epoch(int rank, int64_t clock_offset) {
+    uint64_t epoch = 0;
+
+    if (rank == 0)
+        epoch = get_cycles() + EPOCH_START_DELAY * clock_rate / MILLION;
+    MPI_Bcast(&epoch, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+
+    while ((int64_t)get_cycles() + clock_offset < (int64_t)epoch)
+        ;
+
+    return epoch;
+}
+
+/* Host names */
+
+#define PORT_LENGTH 8
+
+/**
+ * Where every rank listens: rank r on hosts[r], port base + r, so ranks
+ * can share a host.
+ */
+struct dccs_hosts {
+    int size;
+    char *names;    // HOST_NAME_MAX + 1 bytes per rank
+    char **hosts;
+    char **ports;
+};
+
+void free_hosts(struct dccs_hosts *hosts) {
+    for (int r = 0; hosts->ports != NULL && r < hosts->size; r++)
+        free(hosts->ports[r]);
+    free(hosts->ports);
+    free(hosts->hosts);
+    free(hosts->names);
+    memset(hosts, 0, sizeof(struct dccs_hosts));
+}
+
+/**
+ * Gather every rank's host name. Host names must resolve to the addresses
+ * ranks are reached at.
+ */
+int gather_hosts(struct dccs_hosts *hosts, int size, char *base_port) {
+    char host[HOST_NAME_MAX + 1] = {0};
+    unsigned long base = strtoul(base_port, NULL, 10);
+
+    memset(hosts, 0, sizeof(struct dccs_hosts));
+    hosts->size = size;
+    hosts->names = malloc((size_t)size * sizeof host);
+    hosts->hosts = malloc((size_t)size * sizeof(char *));
+    hosts->ports = calloc((size_t)size, sizeof(char *));
+    if (hosts->names == NULL || hosts->hosts == NULL || hosts->ports == NULL) {
+        log_error("Failed to allocate the host names of %d ranks.\n", size);
+        free_hosts(hosts);
+        return -1;
+    }
+
+    gethostname(host, sizeof host - 1);
+    MPI_Allgather(host, sizeof host, MPI_CHAR, hosts->names, sizeof host, MPI_CHAR, MPI_COMM_WORLD);
+    for (int r = 0; r < size; r++) {
+        hosts->hosts[r] = hosts->names + (size_t)r * sizeof host;
+        if ((hosts->ports[r] = malloc(PORT_LENGTH)) == NULL) {
+            free_hosts(hosts);
+            return -1;
+        }
+        snprintf(hosts->ports[r], PORT_LENGTH, "%lu", base + (unsigned long)r);
+    }
+
+    return 0;
+}
+
+#endif // DCCS_MPI_H
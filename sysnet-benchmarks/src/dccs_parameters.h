@@ -10,27 +10,72 @@
 #include <rdma/rdma_cma.h>
 #include <rdma/rdma_verbs.h>
 
-typedef enum { None, Send, Read, Write } Verb;
+typedef enum { None, Send, Read, Write, WriteImm, WriteSend } Verb;
 typedef enum { MODE_LATENCY, MODE_THROUGHPUT } Mode;
 typedef enum { DIR_OUT, DIR_IN, DIR_BOTH } Direction;
 typedef enum { ROLE_CLIENT, ROLE_SERVER } Role;
+typedef enum { TIMING_LOCAL, TIMING_EPOCH } Timing;
+typedef enum { SCHEDULE_ALL, SCHEDULE_SHIFT, SCHEDULE_XOR, SCHEDULE_RANDOM } Schedule;
+typedef enum { PACING_COMPLETION, PACING_SLOT } Pacing;
+typedef enum { FORMAT_CSV, FORMAT_JSON } Format;
+typedef enum { COMPLETION_POLL, COMPLETION_EVENT, COMPLETION_ADAPTIVE } Completion;
+typedef enum { TRANSPORT_MPI, TRANSPORT_VERBS, TRANSPORT_SHM, TRANSPORT_TCP } Transport;
 
 struct dccs_mr_info{
     uint64_t addr;
+    uint64_t length;
     uint32_t rkey;
 };
 
+/**
+ * What send_local_mr_info() sends: the request count and one descriptor per
+ * MR, all in network byte order.
+ */
+struct dccs_mr_table {
+    uint64_t count;
+    uint64_t mr_count;
+    struct dccs_mr_info mrs[];
+};
+
 struct dccs_parameters {
     Verb verb;
     size_t count;
-    size_t length;
+    size_t length;          // Current length, length_max after parsing
+    size_t length_min;      // Sweep from --length-range, a single
+    size_t length_max;      // length (min == max) without one
+    size_t length_factor;
     char *server;
     char *port;
 
     Mode mode;
     size_t warmup_count;
     size_t mr_count;
+    size_t depth;           // Outstanding RDMA requests in throughput mode
+    size_t signal_interval; // Signal every k-th RDMA request
+    size_t post_batch;      // RDMA requests chained per ibv_post_send
+    size_t threads;         // RDMA client threads
+    size_t qps;             // Connections per RDMA client thread
+    size_t clients;         // RDMA clients a server waits for
+    bool srq;               // RDMA server receives through one SRQ and CQ
+    size_t max_inline;      // Inline data asked of the QP, 0 for none
+    size_t inline_limit;    // Inline data the QP was granted
+    Completion completion;  // How completions are waited for
+    size_t poll_budget_us;  // Busy-poll time before blocking in adaptive mode
     int direction;
+    size_t window;
+    Timing timing;
+    Schedule schedule;      // N-N peer schedule, all peers at once by default
+    Pacing pacing;          // When the next step of a schedule starts
+    size_t slot_us;         // Step length for slot pacing
+    Transport transport;    // Backend of the transport benchmarks
+    size_t uptime_us;       // Circuit duty cycle: up time,
+    size_t downtime_us;     // then reconfiguration time
+    bool rotate;            // Next peer every duty cycle
+    uint64_t seed;          // Payload generator seed
+    char *output;           // Summary file written by rank 0, NULL for none
+    Format format;
+    char *pin;              // CPU pinning policy
+    char *nic;              // RDMA device to pin close to, NULL for the first
     bool verbose;
 };
 
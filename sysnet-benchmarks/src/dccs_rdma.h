@@ -28,7 +28,20 @@ static inline uint64_t ntohll(uint64_t x) { return x; }
 
 /* Connection setup/teardown */
 
-int dccs_connect(struct rdma_cm_id **id, char *server, char *port) {
+/**
+ * Inline data limit granted to the QP of id, 0 if it has none.
+ */
+uint32_t dccs_inline_limit(struct rdma_cm_id *id) {
+    struct ibv_qp_attr attr;
+    struct ibv_qp_init_attr init_attr;
+
+    if (id->qp == NULL || ibv_query_qp(id->qp, &attr, IBV_QP_CAP, &init_attr) != 0)
+        return 0;
+
+    return attr.cap.max_inline_data;
+}
+
+int dccs_connect(struct rdma_cm_id **id, char *server, char *port, uint32_t max_inline) {
     struct rdma_addrinfo *res;
     struct rdma_addrinfo hints;
     struct ibv_qp_init_attr attr;
@@ -43,10 +56,17 @@ int dccs_connect(struct rdma_cm_id **id, char *server, char *port) {
 
     memset(&attr, 0, sizeof attr);
     attr.cap.max_send_wr = attr.cap.max_recv_wr = MAX_WR;
+    attr.cap.max_inline_data = max_inline;
     attr.qp_context = *id;
     attr.qp_type = IBV_QPT_RC;
 
-    if ((rv = rdma_create_ep(id, res, NULL, &attr)) != 0) {
+    // The device may not support that much inline data
+    if ((rv = rdma_create_ep(id, res, NULL, &attr)) != 0 && max_inline > 0) {
+        log_warning("Failed to create a QP with %u B of inline data, retrying without.\n", max_inline);
+        attr.cap.max_inline_data = 0;
+        rv = rdma_create_ep(id, res, NULL, &attr);
+    }
+    if (rv != 0) {
         log_perror("rdma_create_ep");
         goto out_free_addrinfo;
     }
@@ -67,7 +87,110 @@ end:
     return rv;
 }
 
-int dccs_listen(struct rdma_cm_id **listen_id, struct rdma_cm_id **id, char *port) {
+/**
+ * Receive side shared by all connections of a server with --srq: one SRQ
+ * and one CQ for the receive completions of every QP, which is how a
+ * server waits on many clients at once. Set up on the first connection.
+ */
+struct dccs_shared_recv {
+    struct ibv_pd *pd;
+    struct ibv_comp_channel *channel;
+    struct ibv_cq *cq;
+    struct ibv_srq *srq;
+};
+
+/**
+ * Create the QP of a just requested connection on the shared receive side.
+ * librdmacm still creates and owns its send CQ.
+ */
+int shared_recv_create_qp(struct dccs_shared_recv *shared, struct rdma_cm_id *id, uint32_t max_inline) {
+    struct ibv_qp_init_attr attr;
+    struct ibv_srq_init_attr srq_attr;
+
+    if (shared->srq == NULL) {
+        shared->pd = id->pd;
+        if ((shared->channel = ibv_create_comp_channel(id->verbs)) == NULL) {
+            log_perror("ibv_create_comp_channel");
+            return -1;
+        }
+        if ((shared->cq = ibv_create_cq(id->verbs, SRQ_SIZE, NULL, shared->channel, 0)) == NULL) {
+            log_perror("ibv_create_cq");
+            return -1;
+        }
+
+        memset(&srq_attr, 0, sizeof srq_attr);
+        srq_attr.attr.max_wr = SRQ_SIZE;
+        srq_attr.attr.max_sge = 1;
+        if ((shared->srq = ibv_create_srq(shared->pd, &srq_attr)) == NULL) {
+            log_perror("ibv_create_srq");
+            return -1;
+        }
+    }
+
+    memset(&attr, 0, sizeof attr);
+    attr.cap.max_send_wr = MAX_WR;
+    attr.cap.max_send_sge = attr.cap.max_recv_sge = 1;
+    attr.cap.max_inline_data = max_inline;
+    attr.recv_cq = shared->cq;
+    attr.srq = shared->srq;
+    attr.qp_context = id;
+    attr.qp_type = IBV_QPT_RC;
+
+    if (rdma_create_qp(id, shared->pd, &attr) != 0) {
+        log_perror("rdma_create_qp");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Destroy the shared receive side, once the QPs using it are gone.
+ */
+void shared_recv_destroy(struct dccs_shared_recv *shared) {
+    if (shared->srq != NULL)
+        ibv_destroy_srq(shared->srq);
+    if (shared->cq != NULL)
+        ibv_destroy_cq(shared->cq);
+    if (shared->channel != NULL)
+        ibv_destroy_comp_channel(shared->channel);
+    memset(shared, 0, sizeof(struct dccs_shared_recv));
+}
+
+/**
+ * Accept the next connection on listen_id, on the shared receive side if
+ * shared is not NULL.
+ */
+int dccs_accept(struct rdma_cm_id *listen_id, struct rdma_cm_id **id, uint32_t max_inline, struct dccs_shared_recv *shared) {
+    int rv;
+
+    // Without a shared receive side, the QP is created here, with the
+    // inline data size asked for at listen
+    if ((rv = rdma_get_request(listen_id, id)) != 0) {
+        log_perror("rdma_get_request");
+        if (max_inline > 0)
+            log_error("The device may not support %u B of inline data, see --inline.\n", max_inline);
+        return rv;
+    }
+
+    if (shared != NULL && (rv = shared_recv_create_qp(shared, *id, max_inline)) != 0) {
+        rdma_destroy_ep(*id);
+        return rv;
+    }
+
+    if ((rv = rdma_accept(*id, NULL)) != 0) {
+        log_perror("rdma_accept");
+        rdma_destroy_ep(*id);
+        return rv;
+    }
+
+    return 0;
+}
+
+/**
+ * Listen on port, without accepting any connection yet.
+ */
+int dccs_create_listener(struct rdma_cm_id **listen_id, char *port, uint32_t max_inline, struct dccs_shared_recv *shared) {
     struct rdma_addrinfo *res;
     struct rdma_addrinfo hints;
     struct ibv_qp_init_attr attr;
@@ -83,9 +206,11 @@ int dccs_listen(struct rdma_cm_id **listen_id, struct rdma_cm_id **id, char *por
 
     memset(&attr, 0, sizeof attr);
     attr.cap.max_send_wr = attr.cap.max_recv_wr = MAX_WR;
+    attr.cap.max_inline_data = max_inline;
     attr.qp_type = IBV_QPT_RC;
-    
-    if ((rv = rdma_create_ep(listen_id, res, NULL, &attr)) != 0) {
+
+    // With a shared receive side, dccs_accept() creates the QPs
+    if ((rv = rdma_create_ep(listen_id, res, NULL, shared == NULL ? &attr : NULL)) != 0) {
         log_perror("rdma_create_ep");
         goto out_free_addrinfo;
     }
@@ -95,23 +220,9 @@ int dccs_listen(struct rdma_cm_id **listen_id, struct rdma_cm_id **id, char *por
         goto out_destroy_listen_ep;
     }
 
-    if ((rv = rdma_get_request(*listen_id, id)) != 0) {
-        log_perror("rdma_get_request");
-        goto out_destroy_listen_ep;
-    }
-
-    // need ibv_query_qp?
-
-    if ((rv = rdma_accept(*id, NULL)) != 0) {
-        log_perror("rdma_accept");
-        goto out_destroy_accept_ep;
-    }
-
     rdma_freeaddrinfo(res);
     return 0;
 
-out_destroy_accept_ep:
-    rdma_destroy_ep(*id);
 out_destroy_listen_ep:
     rdma_destroy_ep(*listen_id);
 out_free_addrinfo:
@@ -120,6 +231,18 @@ end:
     return rv;
 }
 
+int dccs_listen(struct rdma_cm_id **listen_id, struct rdma_cm_id **id, char *port, uint32_t max_inline, struct dccs_shared_recv *shared) {
+    int rv;
+
+    if ((rv = dccs_create_listener(listen_id, port, max_inline, shared)) != 0)
+        return rv;
+
+    if ((rv = dccs_accept(*listen_id, id, max_inline, shared)) != 0)
+        rdma_destroy_ep(*listen_id);
+
+    return rv;
+}
+
 void dccs_client_disconnect(struct rdma_cm_id *id) {
     rdma_disconnect(id);
     rdma_destroy_ep(id);
@@ -168,7 +291,6 @@ void dccs_dereg_mr(struct ibv_mr *mr) {
 
 int dccs_rdma_send_with_flags(struct rdma_cm_id *id, void *addr, size_t length, struct ibv_mr *mr, int flags) {
     int rv;
-    //flags = IBV_SEND_INLINE;    // TODO: check if possible
     //log_debug("RDMA send ...\n");
     if ((rv = rdma_post_send(id, NULL, addr, length, mr, flags)) != 0) {
         log_perror("rdma_post_send");
@@ -225,20 +347,198 @@ static inline int dccs_rdma_write(struct rdma_cm_id *id, void *addr, size_t leng
 
 /* RDMA completion event */
 
+/**
+ * How completions are waited for, and what waiting has cost so far. Set
+ * from the parameters by dccs_cq_wait_init().
+ */
+struct dccs_cq_wait {
+    Completion mode;
+    uint64_t budget_cycles;     // Busy-poll time before blocking in adaptive mode
+    size_t waits;               // Waits that found the CQ empty
+    size_t sleeps;              // Times blocked on a completion channel
+};
+
+extern struct dccs_cq_wait cq_wait;
+
+void dccs_cq_wait_init(struct dccs_parameters *params) {
+    memset(&cq_wait, 0, sizeof cq_wait);
+    cq_wait.mode = params->completion;
+    if (params->completion == COMPLETION_ADAPTIVE)
+        cq_wait.budget_cycles = params->poll_budget_us * clock_rate / MILLION;
+}
+
+/**
+ * Poll cq for up to max completions until there is at least one. In poll
+ * mode this spins; in event mode it blocks on channel as soon as the CQ is
+ * empty, and in adaptive mode once it has spun for the poll budget. A CQ
+ * without a channel is always polled. Returns the number of completions,
+ * or -1 on failure.
+ */
+int dccs_wait_cq(struct ibv_cq *cq, struct ibv_comp_channel *channel, struct ibv_wc *wcs, int max) {
+    struct ibv_cq *event_cq;
+    void *event_context;
+    int rv;
+
+    if ((rv = ibv_poll_cq(cq, max, wcs)) != 0)
+        goto end;
+
+    cq_wait.waits++;
+    bool block = cq_wait.mode != COMPLETION_POLL && channel != NULL;
+    uint64_t deadline = get_cycles() + cq_wait.budget_cycles;
+
+    while ((rv = ibv_poll_cq(cq, max, wcs)) == 0) {
+        if (!block || (cq_wait.mode == COMPLETION_ADAPTIVE && get_cycles() < deadline))
+            continue;
+
+        // Arm, then poll again for completions that raced the arming
+        if (ibv_req_notify_cq(cq, 0) != 0) {
+            log_perror("ibv_req_notify_cq");
+            return -1;
+        }
+        if ((rv = ibv_poll_cq(cq, max, wcs)) != 0)
+            break;
+
+        if (ibv_get_cq_event(channel, &event_cq, &event_context) != 0) {
+            log_perror("ibv_get_cq_event");
+            return -1;
+        }
+        ibv_ack_cq_events(event_cq, 1);
+        cq_wait.sleeps++;
+    }
+
+end:
+    if (rv < 0)
+        log_error("ibv_poll_cq() failed, error = %d.\n", rv);
+    return rv;
+}
+
+/**
+ * A point in time for print_completion_report(): wall clock, CPU time used
+ * by the process, and the completion wait counters.
+ */
+struct dccs_cpu_sample {
+    uint64_t cycles;
+    double cpu_seconds;
+    size_t waits;
+    size_t sleeps;
+};
+
+void sample_cpu(struct dccs_cpu_sample *sample) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    sample->cycles = get_cycles();
+    sample->cpu_seconds = (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+    sample->waits = cq_wait.waits;
+    sample->sleeps = cq_wait.sleeps;
+}
+
+/**
+ * Print the CPU spent since begin against the wall time, to weigh the
+ * completion mode's latency against the cores it keeps busy.
+ */
+void print_completion_report(struct dccs_parameters *params, struct dccs_cpu_sample *begin) {
+    struct dccs_cpu_sample end;
+
+    sample_cpu(&end);
+    double wall_seconds = (double)(end.cycles - begin->cycles) / (double)clock_rate;
+    double cpu_seconds = end.cpu_seconds - begin->cpu_seconds;
+
+    log_info("Completion: mode = %s, budget = %zuµsec, CPU = %.3f ms in %.3f ms (%.1f%%), %zu of %zu waits blocked.\n",
+        completion_name(params->completion), params->completion == COMPLETION_ADAPTIVE ? params->poll_budget_us : 0,
+        cpu_seconds * 1e3, wall_seconds * 1e3, wall_seconds > 0 ? cpu_seconds / wall_seconds * 100 : 0,
+        end.sleeps - begin->sleeps, end.waits - begin->waits);
+}
+
+/* Memory Region cache */
+
+/**
+ * Registrations of control message buffers kept for reuse by send_message()
+ * and recv_message(), found by PD and address range. The least recently
+ * used one is evicted when all MR_CACHE_SIZE are taken. A buffer must be
+ * invalidated before it is freed, as memory allocated later at the same
+ * address need not be backed by the registered pages. Not thread-safe.
+ */
+struct dccs_mr_cache {
+    struct ibv_mr *mrs[MR_CACHE_SIZE];      // NULL when free
+    uint64_t last_used[MR_CACHE_SIZE];
+    uint64_t clock;
+    size_t hits;
+    size_t misses;
+};
+
+extern struct dccs_mr_cache mr_cache;
+
+/**
+ * Get an MR covering length bytes at buf, registering one on a miss.
+ */
+struct ibv_mr * mr_cache_get(struct rdma_cm_id *id, void *buf, size_t length) {
+    uint8_t *begin = buf, *end = begin + length;
+    size_t victim = 0;
+
+    mr_cache.clock++;
+    for (size_t i = 0; i < MR_CACHE_SIZE; i++) {
+        struct ibv_mr *mr = mr_cache.mrs[i];
+        if (mr != NULL && mr->pd == id->pd && (uint8_t *)mr->addr <= begin && end <= (uint8_t *)mr->addr + mr->length) {
+            mr_cache.last_used[i] = mr_cache.clock;
+            mr_cache.hits++;
+            return mr;
+        }
+
+        // Prefer a free entry, then the least recently used
+        if (mr_cache.mrs[victim] != NULL && (mr == NULL || mr_cache.last_used[i] < mr_cache.last_used[victim]))
+            victim = i;
+    }
+
+    struct ibv_mr *mr = dccs_reg_msgs(id, buf, length);
+    if (mr == NULL)
+        return NULL;
+
+    if (mr_cache.mrs[victim] != NULL)
+        dccs_dereg_mr(mr_cache.mrs[victim]);
+    mr_cache.mrs[victim] = mr;
+    mr_cache.last_used[victim] = mr_cache.clock;
+    mr_cache.misses++;
+
+    return mr;
+}
+
+/**
+ * Drop the registrations overlapping length bytes at buf.
+ */
+void mr_cache_invalidate(void *buf, size_t length) {
+    uint8_t *begin = buf, *end = begin + length;
+
+    for (size_t i = 0; i < MR_CACHE_SIZE; i++) {
+        struct ibv_mr *mr = mr_cache.mrs[i];
+        if (mr != NULL && (uint8_t *)mr->addr < end && begin < (uint8_t *)mr->addr + mr->length) {
+            dccs_dereg_mr(mr);
+            mr_cache.mrs[i] = NULL;
+        }
+    }
+}
+
+/**
+ * Drop all registrations, before disconnecting takes their PD away.
+ */
+void mr_cache_flush(void) {
+    for (size_t i = 0; i < MR_CACHE_SIZE; i++) {
+        if (mr_cache.mrs[i] != NULL)
+            dccs_dereg_mr(mr_cache.mrs[i]);
+        mr_cache.mrs[i] = NULL;
+    }
+
+    log_debug("MR cache: %zu hits, %zu misses.\n", mr_cache.hits, mr_cache.misses);
+}
+
 /**
  * Retrieve a completed send, read or write request.
  */
 int dccs_rdma_send_comp(struct rdma_cm_id *id, struct ibv_wc *wc) {
     int rv;
     //log_debug("RDMA send completion ..\n");
-    do {
-        rv = ibv_poll_cq(id->send_cq, 1, wc);
-    } while (rv == 0);
-
-    if (rv < 0) {
-        log_error("ibv_poll_cq() failed, error = %d.\n", rv);
+    if ((rv = dccs_wait_cq(id->send_cq, id->send_cq_channel, wc, 1)) < 0)
         return -1;
-    }
 
     if (wc->status != IBV_WC_SUCCESS) {
         log_error("Failed status %s (%d) for wr_id %d\n",
@@ -250,20 +550,39 @@ int dccs_rdma_send_comp(struct rdma_cm_id *id, struct ibv_wc *wc) {
     return rv;
 }
 
+/**
+ * Reap up to max completed send, read or write requests, waiting for at
+ * least one if wait is set. Returns the number reaped, or -1 on a failed
+ * poll or request.
+ */
+int dccs_rdma_reap_send_comps(struct rdma_cm_id *id, struct ibv_wc *wcs, int max, bool wait) {
+    int rv = wait ? dccs_wait_cq(id->send_cq, id->send_cq_channel, wcs, max) : ibv_poll_cq(id->send_cq, max, wcs);
+
+    if (rv < 0) {
+        if (!wait)
+            log_error("ibv_poll_cq() failed, error = %d.\n", rv);
+        return -1;
+    }
+
+    for (int i = 0; i < rv; i++) {
+        if (wcs[i].status != IBV_WC_SUCCESS) {
+            log_error("Failed status %s (%d) for wr_id %d\n",
+                ibv_wc_status_str(wcs[i].status), wcs[i].status, (int)wcs[i].wr_id);
+            return -1;
+        }
+    }
+
+    return rv;
+}
+
 /**
  * Retrieve a completed receive request.
  */
 int dccs_rdma_recv_comp(struct rdma_cm_id *id, struct ibv_wc *wc) {
     int rv;
     //log_debug("RDMA recv completion ..\n");
-    do {
-        rv = ibv_poll_cq(id->recv_cq, 1, wc);
-    } while (rv == 0);
-
-    if (rv < 0) {
-        log_error("ibv_poll_cq() failed, error = %d.\n", rv);
+    if ((rv = dccs_wait_cq(id->recv_cq, id->recv_cq_channel, wc, 1)) < 0)
         return -1;
-    }
 
     if (wc->status != IBV_WC_SUCCESS) {
         log_error("Failed status %s (%d) for wr_id %d\n",
@@ -290,10 +609,15 @@ int allocate_buffer(struct rdma_cm_id *id, struct dccs_request *requests, struct
     struct ibv_mr *mr = NULL;
     void *buf_base = NULL;
 
+    // The side the data comes from (the server for reads, the client
+    // otherwise) holds payload stream 0; the other side starts on stream 1.
+    bool server = params.server == NULL;
+    uint64_t stream = (verb == Read) == server ? 0 : 1;
+
     for (size_t n = 0; n < count; n++) {
         size_t offset = n % count_per_mr;
         if (offset == 0) {
-            buf_base = malloc_random(buffer_length);
+            buf_base = malloc_payload(buffer_length, params.seed, stream, n * length);
 
             switch (verb) {
                 case Send:
@@ -303,6 +627,8 @@ int allocate_buffer(struct rdma_cm_id *id, struct dccs_request *requests, struct
                     mr = dccs_reg_read(id, buf_base, buffer_length);
                     break;
                 case Write:
+                case WriteImm:
+                case WriteSend:
                     mr = dccs_reg_write(id, buf_base, buffer_length);
                     break;
                 default:
@@ -340,384 +666,727 @@ void deallocate_buffer(struct dccs_request *requests, struct dccs_parameters par
     }
 }
 
-/* Exchange MR information. */
+/**
+ * Lay the requests out densely for params->length within the buffers and
+ * remote MRs set up for params->length_max, so one connection and one set
+ * of MRs serve a whole --length-range sweep. The first request of each MR
+ * always sits at its base.
+ */
+void set_request_length(struct dccs_request *requests, struct dccs_parameters *params) {
+    size_t count_per_mr = params->count / params->mr_count;
+    size_t length = params->length;
+
+    for (size_t n = 0; n < params->count; n++) {
+        struct dccs_request *base = requests + n - n % count_per_mr;
+        struct dccs_request *request = requests + n;
+        size_t offset = n % count_per_mr * length;
+
+        request->buf = (void *)((uint8_t *)base->buf + offset);
+        request->remote_addr = base->remote_addr + offset;
+        request->length = length;
+    }
+}
+
+/* Simple wrapper for sending/receiving a single request */
 
 /**
- * Get RDMA MR information from remote peer.
+ * Send a control message, with buf registered through the MR cache.
  */
-int get_remote_mr_info(struct rdma_cm_id *id, struct dccs_request *requests, size_t count) {
-    struct ibv_mr *mr_count, *mr_array;
+int send_message(struct rdma_cm_id *id, void* buf, size_t length) {
+    struct ibv_mr *mr;
     struct ibv_wc wc;
     int rv = -1;
 
-    // TODO: only transmit one MR
+    if ((mr = mr_cache_get(id, buf, length)) == NULL)
+        goto end;
+    if ((rv = dccs_rdma_send(id, buf, length, mr)) != 0) {
+        log_error("Failed to send message.\n");
+        goto end;
+    }
+    while ((rv = dccs_rdma_send_comp(id, &wc)) == 0);
+    if (rv < 0)
+        log_error("Failed to send comp message.\n");
 
-#if VERBOSE_TIMING
-    uint64_t t = get_cycles();
-#endif
-    // Allocate array
-    size_t array_size = count * sizeof(struct dccs_mr_info);
-    struct dccs_mr_info *mr_infos = malloc(array_size);
-    memset(mr_infos, 0, array_size);
-#if VERBOSE_TIMING
-    t = get_cycles() - t;
-    log_verbose("Time taken to allocate MR structs: %.3f µsec.\n", get_time_in_microseconds(t));
+end:
+    return rv;
+}
 
-    t = get_cycles();
-#endif
-    size_t rcount = 0;
-    if ((mr_count = dccs_reg_msgs(id, &rcount, sizeof rcount)) == NULL)
-        goto out_free_buf;
-    if ((mr_array = dccs_reg_msgs(id, mr_infos, array_size)) == NULL)
-        goto out_dereg_mr_count;
-#if VERBOSE_TIMING
-    t = get_cycles() - t;
-    log_verbose("Time taken to regiser MR infos: %.3f µsec.\n", get_time_in_microseconds(t));
+/**
+ * Receive a control message, with buf registered through the MR cache.
+ */
+int recv_message(struct rdma_cm_id *id, void* buf, size_t length) {
+    struct ibv_mr *mr;
+    struct ibv_wc wc;
+    int rv = -1;
 
-    t = get_cycles();
-#endif
-    // Receive count
-    if ((rv = dccs_rdma_recv(id, &rcount, sizeof rcount, mr_count)) != 0) {
-        log_error("Failed to recv # of RDMA requests to remote side.\n");
-        goto failure;
+    if ((mr = mr_cache_get(id, buf, length)) == NULL)
+        goto end;
+    if ((rv = dccs_rdma_recv(id, buf, length, mr)) != 0) {
+        log_error("Failed to recv message.\n");
+        goto end;
     }
     while ((rv = dccs_rdma_recv_comp(id, &wc)) == 0);
-    if (rv < 0) {
-        log_error("Failed to recv comp # of RDMA requests to remote side.\n");
-        goto failure;
-    }
-#if VERBOSE_TIMING
-    t = get_cycles() - t;
-    log_verbose("Time taken to receive count: %.3f µsec.\n", get_time_in_microseconds(t));
-#endif
+    if (rv < 0)
+        log_error("Failed to recv comp message.\n");
 
-    if (rcount != count) {
-        log_error("Inconsistent request count: local is %zu, remote is %zu.\n", count, rcount);
-        goto failure;
-    }
+end:
+    return rv;
+}
 
-#if VERBOSE_TIMING
-    t = get_cycles();
-#endif
-    // Receive RDMA read/write info
-    if ((rv = dccs_rdma_recv(id, mr_infos, array_size, mr_array)) != 0) {
-        log_error("Failed to recv RDMA read/write request info to remote side.\n");
-        goto failure;
-    }
-    while ((rv = dccs_rdma_recv_comp(id, &wc)) == 0);
-    if (rv < 0) {
-        log_error("Failed to recv comp RDMA read/write request info to remote side.\n");
-        goto failure;
+/* Round synchronization */
+
+/**
+ * Start a round on each of count clients with a SYNC_START_MESSAGE on its
+ * first connection, at starts[c] on our clock.
+ */
+int start_clients(struct rdma_cm_id **clients, size_t count, uint64_t *starts) {
+    char start_message[SYNC_START_MESSAGE_LENGTH] = SYNC_START_MESSAGE;
+
+    for (size_t c = 0; c < count; c++) {
+        starts[c] = get_cycles();
+        if (send_message(clients[c], start_message, SYNC_START_MESSAGE_LENGTH) < 0)
+            return -1;
     }
-#if VERBOSE_TIMING
-    t = get_cycles() - t;
-    log_verbose("Time taken to receive MR infos: %.3f µsec.\n", get_time_in_microseconds(t));
 
-    t = get_cycles();
-#endif
-    // Process received info
-    for (size_t n = 0; n < count; n++) {
-        struct dccs_request *request = requests + n;
-        struct dccs_mr_info *mr_info = mr_infos + n;
-        request->remote_addr = ntohll(mr_info->addr);
-        request->remote_rkey = ntohl(mr_info->rkey);
+    return 0;
+}
+
+/**
+ * Start a round on each of count clients and wait for its
+ * SYNC_END_MESSAGE. A client's round
+ * runs from starts[c] to ends[c] on our clock. The ends come through the
+ * SRQ and CQ of shared if it is not NULL, and the clients' receive CQs are
+ * polled in turn otherwise.
+ */
+int serve_round(struct rdma_cm_id **clients, size_t count, struct dccs_shared_recv *shared, uint64_t *starts, uint64_t *ends) {
+    size_t buffer_size = count * SYNC_END_MESSAGE_LENGTH;
+    struct ibv_wc wcs[CQ_POLL_BATCH];
+    struct ibv_mr *mr;
+    size_t ended = 0;
+    int rv = -1;
+
+    char *buffers = calloc(count, SYNC_END_MESSAGE_LENGTH);
+    if (buffers == NULL || (mr = mr_cache_get(clients[0], buffers, buffer_size)) == NULL)
+        goto out_free;
+
+    // Receives go first, so no end arrives before them
+    for (size_t c = 0; c < count; c++) {
+        char *buffer = buffers + c * SYNC_END_MESSAGE_LENGTH;
+        ends[c] = 0;
+        if (shared != NULL) {
+            struct ibv_sge sge = { (uint64_t)(uintptr_t)buffer, SYNC_END_MESSAGE_LENGTH, mr->lkey };
+            struct ibv_recv_wr wr = { c, NULL, &sge, 1 }, *bad_wr;
+            if (ibv_post_srq_recv(shared->srq, &wr, &bad_wr) != 0) {
+                log_perror("ibv_post_srq_recv");
+                goto out_free;
+            }
+        } else if (dccs_rdma_recv(clients[c], buffer, SYNC_END_MESSAGE_LENGTH, mr) != 0) {
+            goto out_free;
+        }
     }
-#if VERBOSE_TIMING
-    t = get_cycles() - t;
-    log_verbose("Time taken to copy MR infos: %.3f µsec.\n", get_time_in_microseconds(t));
 
-    t = get_cycles();
-#endif
-failure:
-// out_dereg_mr_array:
-    dccs_dereg_mr(mr_array);
-out_dereg_mr_count:
-    dccs_dereg_mr(mr_count);
-out_free_buf:
-    free(mr_infos);
+    if (start_clients(clients, count, starts) != 0)
+        goto out_free;
 
-#if VERBOSE_TIMING
-    t = get_cycles() - t;
-    log_verbose("Time taken to clean up: %.3f µsec.\n", get_time_in_microseconds(t));
-#endif
+    while (ended < count) {
+        int polled = 0;
+        if (shared != NULL) {
+            polled = dccs_wait_cq(shared->cq, shared->channel, wcs, CQ_POLL_BATCH);
+        } else {
+            for (size_t c = 0; c < count && polled == 0; c++)
+                polled = ends[c] == 0 ? ibv_poll_cq(clients[c]->recv_cq, 1, wcs) : 0;
+        }
+        if (polled < 0)
+            goto out_free;
+
+        uint64_t now = get_cycles();
+        for (int i = 0; i < polled; i++) {
+            if (wcs[i].status != IBV_WC_SUCCESS) {
+                log_error("Failed status %s (%d) for end of client %d\n",
+                    ibv_wc_status_str(wcs[i].status), wcs[i].status, (int)wcs[i].wr_id);
+                goto out_free;
+            }
 
+            // The SRQ's buffers are not tied to a client, its QP is
+            size_t c = 0;
+            while (c < count && clients[c]->qp->qp_num != wcs[i].qp_num)
+                c++;
+            if (c == count) {
+                log_error("End from unknown QP %u.\n", wcs[i].qp_num);
+                goto out_free;
+            }
+            ends[c] = now;
+            ended++;
+        }
+    }
+    rv = 0;
+
+out_free:
+    mr_cache_invalidate(buffers, buffer_size);
+    free(buffers);
     return rv;
 }
 
+/* Receive ring */
+
 /**
- * Send RDMA MR information to remote peer.
+ * Receive buffers kept posted for two-sided requests, size of them per
+ * receive queue: each connection's own, or the one SRQ of shared. Every
+ * message is copied out to the next request of its connection, so its
+ * buffer is free again at once; freed buffers are reposted in chains of
+ * batch. The message after a connection's slice requests is
+ * its client's SYNC_END_MESSAGE.
+ *
+ * Writes with immediate and write+send requests only notify the ring:
+ * their data is already in place, and the completion's immediate or the
+ * following send carries the request's sequence number instead.
  */
-int send_local_mr_info(struct rdma_cm_id *id, struct dccs_request *requests, size_t count, size_t length) {
-    struct ibv_mr *mr_count, *mr_array;
-    struct ibv_wc wc;
-    int rv = -1;
+struct dccs_recv_ring {
+    struct dccs_shared_recv *shared;
+    struct rdma_cm_id **ids;
+    size_t connections;
+    size_t per_client;          // Connections per client
+    size_t queues;              // 1 with an SRQ, connections otherwise
+    size_t size;                // Buffers per queue
+    size_t batch;               // Buffers per repost
+    size_t length;              // Bytes per buffer
+    uint8_t *buffers;           // Buffer i of queue q at (q * size + i) * length
+    struct ibv_mr *mr;
+    uint64_t *free_slots;       // Per queue, buffers to repost
+    size_t *free_counts;
+    struct dccs_request *requests;
+    size_t slice;               // Requests per connection
+    size_t *received;           // Per connection, this round
+    struct ibv_recv_wr wrs[RECV_REPOST_BATCH];
+    struct ibv_sge sges[RECV_REPOST_BATCH];
+    Verb verb;
+    size_t reposts;
+    size_t misordered;          // Sequence numbers other than expected, this round
+};
 
-    // TODO: only transmit one MR
+/**
+ * Whether the server takes verb's requests in through the ring.
+ */
+static inline bool uses_recv_ring(Verb verb) {
+    return verb == Send || verb == WriteImm || verb == WriteSend;
+}
 
-#if VERBOSE_TIMING
-    uint64_t t = get_cycles();
-#endif
-    size_t array_size = count * sizeof(struct dccs_mr_info);
-    struct dccs_mr_info *mr_infos = malloc(array_size);
-    memset(mr_infos, 0, array_size);
+/**
+ * Bytes per receive buffer: a whole message for Send, a sequence number
+ * for the write variants.
+ */
+static inline size_t ring_length(struct dccs_parameters *params) {
+    return params->verb == Send ? params->length_max : RECV_NOTIFY_LENGTH;
+}
 
-    for (size_t n = 0; n < count; n++) {
-        struct dccs_request *request = requests + n;
-        struct dccs_mr_info *mr_info = mr_infos + n;
-        mr_info->addr = htonll((uint64_t)request->buf);
-        mr_info->rkey = htonl(request->mr->rkey);
-    }
-#if VERBOSE_TIMING
-    t = get_cycles() - t;
-    log_verbose("Time taken to allocate MR structs: %.3f µsec.\n", get_time_in_microseconds(t));
+static inline size_t ring_size(size_t length) {
+    size_t size = RECV_RING_BYTES / length;
+    return size < 1 ? 1 : size > RECV_RING_SIZE ? RECV_RING_SIZE : size;
+}
 
-    t = get_cycles();
-#endif
-    if ((mr_count = dccs_reg_msgs(id, &count, sizeof count)) == NULL)
-        goto out_free_buf;
-    if ((mr_array = dccs_reg_msgs(id, mr_infos, array_size)) == NULL)
-        goto out_dereg_mr_count;
-#if VERBOSE_TIMING
-    t = get_cycles() - t;
-    log_verbose("Time taken to register MR infos: %.3f µsec.\n", get_time_in_microseconds(t));
+/**
+ * Post the free buffers of queue q as one chain.
+ */
+int ring_repost(struct dccs_recv_ring *ring, size_t q) {
+    uint64_t *slots = ring->free_slots + q * ring->size;
+    struct ibv_recv_wr *bad_wr;
+
+    while (ring->free_counts[q] > 0) {
+        size_t n = ring->free_counts[q] < ring->batch ? ring->free_counts[q] : ring->batch;
+        ring->free_counts[q] -= n;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t slot = slots[ring->free_counts[q] + i];
+            ring->sges[i].addr = (uint64_t)(uintptr_t)(ring->buffers + slot * ring->length);
+            ring->sges[i].length = (uint32_t)ring->length;
+            ring->sges[i].lkey = ring->mr->lkey;
+            ring->wrs[i].wr_id = slot;
+            ring->wrs[i].next = i + 1 < n ? ring->wrs + i + 1 : NULL;
+            ring->wrs[i].sg_list = ring->sges + i;
+            ring->wrs[i].num_sge = 1;
+        }
 
-    t = get_cycles();
-#endif
-    if ((rv = dccs_rdma_send(id, &count, sizeof count, mr_count)) != 0) {
-        log_error("Failed to send # of RDMA requests to remote side.\n");
-        goto failure;
-    }
-    while ((rv = dccs_rdma_send_comp(id, &wc)) == 0);
-    if (rv < 0) {
-        log_error("Failed to send comp # of RDMA requests to remote side.\n");
-        goto failure;
+        int rv = ring->shared != NULL ? ibv_post_srq_recv(ring->shared->srq, ring->wrs, &bad_wr)
+            : ibv_post_recv(ring->ids[q]->qp, ring->wrs, &bad_wr);
+        if (rv != 0) {
+            log_error("Failed to post %zu receives, error = %d.\n", n, rv);
+            return -1;
+        }
+        ring->reposts++;
     }
-#if VERBOSE_TIMING
-    t = get_cycles() - t;
-    log_verbose("Time taken to send count: %.3f µsec.\n", get_time_in_microseconds(t));
 
-    t = get_cycles();
-#endif
-    if ((rv = dccs_rdma_send(id, mr_infos, array_size, mr_array)) != 0) {
-        log_error("Failed to send RDMA read/write request info to remote side.\n");
-        goto failure;
+    return 0;
+}
+
+/**
+ * Set up and post a ring for the connections of a server, whose requests
+ * hold slice per connection.
+ */
+int ring_init(struct dccs_recv_ring *ring, struct rdma_cm_id **ids, size_t connections, struct dccs_shared_recv *shared,
+        struct dccs_request *requests, struct dccs_parameters *params) {
+    memset(ring, 0, sizeof(struct dccs_recv_ring));
+    ring->shared = shared;
+    ring->ids = ids;
+    ring->connections = connections;
+    ring->per_client = params->threads * params->qps;
+    ring->queues = shared != NULL ? 1 : connections;
+    ring->length = ring_length(params);
+    ring->size = ring_size(ring->length);
+    ring->batch = ring->size < RECV_REPOST_BATCH ? ring->size : RECV_REPOST_BATCH;
+    ring->requests = requests;
+    ring->slice = params->count / ring->per_client;
+    ring->verb = params->verb;
+
+    size_t buffer_size = ring->queues * ring->size * ring->length;
+    ring->buffers = malloc(buffer_size);
+    ring->free_slots = malloc(ring->queues * ring->size * sizeof(uint64_t));
+    ring->free_counts = calloc(ring->queues, sizeof(size_t));
+    ring->received = calloc(connections, sizeof(size_t));
+    if (ring->buffers == NULL || ring->free_slots == NULL || ring->free_counts == NULL || ring->received == NULL) {
+        log_error("Failed to allocate a receive ring of %zu B.\n", buffer_size);
+        return -1;
     }
-    while ((rv = dccs_rdma_send_comp(id, &wc)) == 0);
-    if (rv < 0) {
-        log_error("Failed to send comp RDMA read/write request info to remote side.\n");
-        goto failure;
+    if ((ring->mr = dccs_reg_msgs(ids[0], ring->buffers, buffer_size)) == NULL)
+        return -1;
+
+    for (size_t q = 0; q < ring->queues; q++) {
+        for (size_t i = 0; i < ring->size; i++)
+            ring->free_slots[q * ring->size + i] = q * ring->size + i;
+        ring->free_counts[q] = ring->size;
+        if (ring_repost(ring, q) != 0)
+            return -1;
     }
-#if VERBOSE_TIMING
-    t = get_cycles() - t;
-    log_verbose("Time taken to send MR infos: %.3f µsec.\n", get_time_in_microseconds(t));
 
-    t = get_cycles();
-#endif
-failure:
-// out_dereg_mr_array:
-    dccs_dereg_mr(mr_array);
-out_dereg_mr_count:
-    dccs_dereg_mr(mr_count);
-out_free_buf:
-    free(mr_infos);
+    return 0;
+}
 
-#if VERBOSE_TIMING
-    t = get_cycles() - t;
-    log_verbose("Time taken to clean up: %.3f µsec.\n", get_time_in_microseconds(t));
-#endif
+/**
+ * Free a ring; its receives still posted are flushed with their QPs.
+ */
+void ring_destroy(struct dccs_recv_ring *ring) {
+    if (ring->mr != NULL)
+        dccs_dereg_mr(ring->mr);
+    free(ring->buffers);
+    free(ring->free_slots);
+    free(ring->free_counts);
+    free(ring->received);
+    memset(ring, 0, sizeof(struct dccs_recv_ring));
+}
 
-    return rv;
+/**
+ * Start a round on each of count clients and take in all of their
+ * requests and ends through the ring, which then runs from starts[c] to
+ * ends[c] on our clock for client c.
+ */
+int serve_ring_round(struct dccs_recv_ring *ring, struct rdma_cm_id **clients, size_t count, uint64_t *starts, uint64_t *ends) {
+    struct ibv_wc wcs[CQ_POLL_BATCH];
+    size_t remaining = ring->connections * ring->slice, ended = 0;
+
+    memset(ring->received, 0, ring->connections * sizeof(size_t));
+    ring->misordered = 0;
+    for (size_t c = 0; c < count; c++)
+        ends[c] = 0;
+
+    if (start_clients(clients, count, starts) != 0)
+        return -1;
+
+    // Ends can overtake other connections' requests of the same client
+    size_t next = 0;
+    while (ended < count || remaining > 0) {
+        int polled = 0;
+        if (ring->shared != NULL) {
+            polled = dccs_wait_cq(ring->shared->cq, ring->shared->channel, wcs, CQ_POLL_BATCH);
+        } else {
+            for (size_t i = 0; i < ring->connections && polled == 0; i++, next = (next + 1) % ring->connections)
+                polled = ibv_poll_cq(ring->ids[next]->recv_cq, CQ_POLL_BATCH, wcs);
+        }
+        if (polled < 0) {
+            log_error("ibv_poll_cq() failed, error = %d.\n", polled);
+            return -1;
+        }
+
+        uint64_t now = get_cycles();
+        for (int i = 0; i < polled; i++) {
+            struct ibv_wc *wc = wcs + i;
+            if (wc->status != IBV_WC_SUCCESS) {
+                log_error("Failed status %s (%d) for receive %d\n",
+                    ibv_wc_status_str(wc->status), wc->status, (int)wc->wr_id);
+                return -1;
+            }
+
+            size_t c = 0;
+            while (c < ring->connections && ring->ids[c]->qp->qp_num != wc->qp_num)
+                c++;
+            if (c == ring->connections) {
+                log_error("Receive from unknown QP %u.\n", wc->qp_num);
+                return -1;
+            }
+
+            uint8_t *buffer = ring->buffers + wc->wr_id * ring->length;
+            if (ring->received[c] < ring->slice) {
+                size_t seq = ring->received[c]++;
+                if (ring->verb == Send) {
+                    memcpy(ring->requests[c * ring->slice + seq].buf, buffer, wc->byte_len);
+                } else {
+                    uint32_t imm;
+                    if (wc->opcode == IBV_WC_RECV_RDMA_WITH_IMM)
+                        imm = wc->imm_data;
+                    else
+                        memcpy(&imm, buffer, sizeof imm);
+                    if (ntohl(imm) != seq)
+                        ring->misordered++;
+                }
+                ring->requests[c * ring->slice + seq].end = now;
+                remaining--;
+            } else {
+                ends[c / ring->per_client] = now;
+                ended++;
+            }
+
+            size_t q = ring->shared != NULL ? 0 : c;
+            ring->free_slots[q * ring->size + ring->free_counts[q]++] = wc->wr_id;
+            if (ring->free_counts[q] >= ring->batch && ring_repost(ring, q) != 0)
+                return -1;
+        }
+    }
+
+    return 0;
 }
 
-/* Simple wrapper for sending/receiving a single request */
+/* Exchange MR information. */
 
-int send_message(struct rdma_cm_id *id, void* buf, size_t length) {
-    struct ibv_mr *mr;
-    struct ibv_wc wc;
+/**
+ * Get RDMA MR information from remote peer: one descriptor per MR, each
+ * request's remote address being its offset into its MR.
+ */
+int get_remote_mr_info(struct rdma_cm_id *id, struct dccs_request *requests, size_t count, size_t mr_count, size_t length) {
+    size_t count_per_mr = count / mr_count;
+    size_t table_size = sizeof(struct dccs_mr_table) + mr_count * sizeof(struct dccs_mr_info);
     int rv = -1;
 
-    if ((mr = dccs_reg_msgs(id, buf, length)) == NULL)
-        goto end;
-    if ((rv = dccs_rdma_send(id, buf, length, mr)) != 0) {
-        log_error("Failed to send message.\n");
-        goto out_dereg_mr;
+    uint64_t t = get_cycles();
+    struct dccs_mr_table *table = calloc(1, table_size);
+    if (table == NULL) {
+        log_error("Failed to allocate %zu MR descriptors.\n", mr_count);
+        return -1;
     }
-    while ((rv = dccs_rdma_send_comp(id, &wc)) == 0);
-    if (rv < 0) {
-        log_error("Failed to send comp message.\n");
-        goto out_dereg_mr;
+
+    // A peer with more MRs fails this receive with a length error
+    if ((rv = recv_message(id, table, table_size)) < 0) {
+        log_error("Failed to recv RDMA read/write request info from remote side.\n");
+        goto out_free;
     }
 
-out_dereg_mr:
-    dccs_dereg_mr(mr);
-end:
+    if (ntohll(table->count) != count || ntohll(table->mr_count) != mr_count) {
+        log_error("Inconsistent requests: local is %zu in %zu MRs, remote is %lu in %lu MRs.\n",
+            count, mr_count, ntohll(table->count), ntohll(table->mr_count));
+        rv = -1;
+        goto out_free;
+    }
+
+    for (size_t m = 0; m < mr_count; m++) {
+        struct dccs_mr_info *mr_info = table->mrs + m;
+        uint64_t addr = ntohll(mr_info->addr);
+        uint32_t rkey = ntohl(mr_info->rkey);
+
+        if (ntohll(mr_info->length) < count_per_mr * length) {
+            log_error("Remote MR %zu is %lu B, short of %zu requests of %zu B.\n", m, ntohll(mr_info->length), count_per_mr, length);
+            rv = -1;
+            goto out_free;
+        }
+
+        for (size_t n = m * count_per_mr; n < (m + 1) * count_per_mr; n++) {
+            requests[n].remote_addr = addr + (n - m * count_per_mr) * length;
+            requests[n].remote_rkey = rkey;
+        }
+    }
+
+    log_debug("Received %zu MR descriptors for %zu requests in %.3f µsec.\n", mr_count, count, get_time_in_microseconds(get_cycles() - t));
+
+out_free:
+    mr_cache_invalidate(table, table_size);
+    free(table);
     return rv;
 }
 
-int recv_message(struct rdma_cm_id *id, void* buf, size_t length) {
-    struct ibv_mr *mr;
-    struct ibv_wc wc;
-    int rv = -1;
+/**
+ * Send RDMA MR information to remote peer: one descriptor per MR.
+ */
+int send_local_mr_info(struct rdma_cm_id *id, struct dccs_request *requests, size_t count, size_t mr_count) {
+    size_t count_per_mr = count / mr_count;
+    size_t table_size = sizeof(struct dccs_mr_table) + mr_count * sizeof(struct dccs_mr_info);
+    int rv;
 
-    if ((mr = dccs_reg_msgs(id, buf, length)) == NULL)
-        goto end;
-    if ((rv = dccs_rdma_recv(id, buf, length, mr)) != 0) {
-        log_error("Failed to recv message.\n");
-        goto out_dereg_mr;
+    uint64_t t = get_cycles();
+    struct dccs_mr_table *table = calloc(1, table_size);
+    if (table == NULL) {
+        log_error("Failed to allocate %zu MR descriptors.\n", mr_count);
+        return -1;
     }
-    while ((rv = dccs_rdma_recv_comp(id, &wc)) == 0);
-    if (rv < 0) {
-        log_error("Failed to recv comp message.\n");
-        goto out_dereg_mr;
+
+    table->count = htonll(count);
+    table->mr_count = htonll(mr_count);
+    for (size_t m = 0; m < mr_count; m++) {
+        struct ibv_mr *mr = requests[m * count_per_mr].mr;
+        table->mrs[m].addr = htonll((uint64_t)(uintptr_t)mr->addr);
+        table->mrs[m].length = htonll(mr->length);
+        table->mrs[m].rkey = htonl(mr->rkey);
     }
 
-out_dereg_mr:
-    dccs_dereg_mr(mr);
-end:
+    if ((rv = send_message(id, table, table_size)) < 0)
+        log_error("Failed to send RDMA read/write request info to remote side.\n");
+    else
+        log_debug("Sent %zu MR descriptors for %zu requests in %.3f µsec.\n", mr_count, count, get_time_in_microseconds(get_cycles() - t));
+
+    mr_cache_invalidate(table, table_size);
+    free(table);
     return rv;
 }
 
 /* Wrapper for sending/receiving multiple requests */
 
 /**
- * Send multiple RDMA requests.
+ * Fill in the work request for a request; its completion carries wr_id.
  */
-int send_requests(struct rdma_cm_id *id, struct dccs_request *requests, size_t count) {
+static inline void build_send_wr(struct dccs_request *request, uint64_t wr_id, unsigned int flags, struct ibv_send_wr *wr, struct ibv_sge *sge) {
+    sge->addr = (uint64_t)(uintptr_t)request->buf;
+    sge->length = (uint32_t)request->length;
+    sge->lkey = request->mr->lkey;
+
+    memset(wr, 0, sizeof(struct ibv_send_wr));
+    wr->wr_id = wr_id;
+    wr->sg_list = sge;
+    wr->num_sge = 1;
+    wr->send_flags = flags;
+    switch (request->verb) {
+        case Read:
+            wr->opcode = IBV_WR_RDMA_READ;
+            break;
+        case Write:
+        case WriteSend:
+            wr->opcode = IBV_WR_RDMA_WRITE;
+            break;
+        case WriteImm:
+            // The receiver gets the sequence number with its completion
+            wr->opcode = IBV_WR_RDMA_WRITE_WITH_IMM;
+            wr->imm_data = htonl((uint32_t)wr_id);
+            break;
+        default:
+            wr->opcode = IBV_WR_SEND;
+            break;
+    }
+    if (wr->opcode != IBV_WR_SEND) {
+        wr->wr.rdma.remote_addr = request->remote_addr;
+        wr->wr.rdma.rkey = request->remote_rkey;
+    }
+}
+
+/**
+ * Post requests first .. first + n - 1 as one chain of work requests, with
+ * a single ibv_post_send and so a single doorbell. Request i is signaled
+ * if (i + 1) is a multiple of interval or it is the last of count; its
+ * completion carries wr_id i. Sends and writes of up to inline_limit bytes
+ * are posted inline. A write+send request is a write followed by a send
+ * of its index from the sequence numbers of seq_mr, which then takes the
+ * signal, or without seq_mr just the write. wrs and sges hold at least 2n
+ * entries.
+ */
+int post_requests(struct rdma_cm_id *id, struct dccs_request *requests, size_t first, size_t n, size_t interval, size_t count,
+        size_t inline_limit, struct ibv_mr *seq_mr, struct ibv_send_wr *wrs, struct ibv_sge *sges) {
+    struct ibv_send_wr *bad_wr = NULL;
+    size_t w = 0;
     int rv;
-    int failed_count = 0;
 
-    uint64_t start = get_cycles();
+    for (size_t i = 0; i < n; i++) {
+        size_t index = first + i;
+        unsigned int flags = (index + 1) % interval == 0 || index == count - 1 ? IBV_SEND_SIGNALED : 0;
+        if (requests[index].verb != Read && requests[index].length <= inline_limit)
+            flags |= IBV_SEND_INLINE;
 
-    for (size_t n = 0; n < count; n++) {
-        struct dccs_request *request = requests + n;
-        switch (request->verb) {
-            case Send:
-                rv = dccs_rdma_send(id, request->buf, request->length, request->mr);
-                request->start = get_cycles();
-                if (rv != 0)
-                    failed_count++;
-                break;
-            case Read:
-                rv = dccs_rdma_read(id, request->buf, request->length, request->mr, request->remote_addr, request->remote_rkey);
-                request->start = get_cycles();
-                if (rv != 0)
-                    failed_count++;
-                break;
-            case Write:
-                rv = dccs_rdma_write(id, request->buf, request->length, request->mr, request->remote_addr, request->remote_rkey);
-                request->start = get_cycles();
-                if (rv != 0)
-                    failed_count++;
-                break;
-            default:
-                log_warning("Unrecognized request (n = %zu).", n);
-                break;
+        if (requests[index].verb != WriteSend || seq_mr == NULL) {
+            build_send_wr(requests + index, index, flags, wrs + w, sges + w);
+            w++;
+            continue;
         }
+
+        build_send_wr(requests + index, index, flags & ~(unsigned int)IBV_SEND_SIGNALED, wrs + w, sges + w);
+        w++;
+        sges[w].addr = (uint64_t)(uintptr_t)((uint32_t *)seq_mr->addr + index);
+        sges[w].length = sizeof(uint32_t);
+        sges[w].lkey = seq_mr->lkey;
+        memset(wrs + w, 0, sizeof(struct ibv_send_wr));
+        wrs[w].wr_id = index;
+        wrs[w].sg_list = sges + w;
+        wrs[w].num_sge = 1;
+        wrs[w].opcode = IBV_WR_SEND;
+        wrs[w].send_flags = (flags & IBV_SEND_SIGNALED) | (sizeof(uint32_t) <= inline_limit ? IBV_SEND_INLINE : 0);
+        w++;
     }
+    for (size_t i = 0; i < w; i++)
+        wrs[i].next = i + 1 < w ? wrs + i + 1 : NULL;
 
-    uint64_t end = get_cycles();
-    log_debug("Time elapsed to send all requests: %.3f µsec.\n", (double)(end - start) * 1e6 / 2.4e9);
+    if ((rv = ibv_post_send(id->qp, wrs, &bad_wr)) != 0) {
+        log_error("ibv_post_send() failed at request %zu: %s.\n", first + (size_t)(bad_wr - wrs) / (w / n), strerror(rv));
+        return -1;
+    }
 
-    return -failed_count;
+    return 0;
 }
 
 /**
- * Wait for multiple RDMA requests to finish.
+ * The requests of one QP in flight: up to depth of them outstanding on the
+ * send queue, every interval-th and the last one signaled, and up to batch
+ * posted per doorbell. A signaled completion also completes the unsignaled
+ * requests before it, which are given its completion time.
  */
-int wait_requests(struct rdma_cm_id *id, struct dccs_request *requests, size_t count) {
-    int rv;
-    int failed_count = 0;
-    struct ibv_wc wc;
+struct dccs_pipeline {
+    struct rdma_cm_id *id;
+    struct dccs_request *requests;
+    size_t count;
+    size_t depth;
+    size_t interval;
+    size_t batch;
+    size_t inline_limit;
+    size_t posted;
+    size_t completed;
+    struct ibv_send_wr *wrs;    // two per request of a batch
+    struct ibv_sge *sges;
+    struct ibv_mr *seq_mr;      // sequence numbers sent after each write+send write
+    int doorbells;
+    int polls;
+    int reaped;
+};
 
-    for (size_t n = 0; n < count; n++) {
-        struct dccs_request *request = requests + n;
-        rv = dccs_rdma_send_comp(id, &wc);
-        request->end = get_cycles();
-        if (rv < 0)
-            failed_count++;
+/**
+ * Set up a pipeline for count requests on id. Latency mode is the special
+ * case of depth 1, every request signaled.
+ */
+int pipeline_init(struct dccs_pipeline *pipeline, struct rdma_cm_id *id, struct dccs_request *requests, size_t count, struct dccs_parameters *params) {
+    memset(pipeline, 0, sizeof(struct dccs_pipeline));
+    pipeline->id = id;
+    pipeline->requests = requests;
+    pipeline->count = count;
+    pipeline->depth = params->mode == MODE_LATENCY ? 1 : params->depth;
+    pipeline->interval = params->mode == MODE_LATENCY ? 1 : params->signal_interval;
+    pipeline->batch = params->post_batch < pipeline->depth ? params->post_batch : pipeline->depth;
+    pipeline->inline_limit = params->inline_limit;
+
+    pipeline->wrs = malloc(2 * pipeline->batch * sizeof(struct ibv_send_wr));
+    pipeline->sges = malloc(2 * pipeline->batch * sizeof(struct ibv_sge));
+    if (pipeline->wrs == NULL || pipeline->sges == NULL) {
+        log_error("Failed to allocate a post batch of %zu.\n", pipeline->batch);
+        goto out_free;
+    }
+
+    if (params->verb == WriteSend) {
+        uint32_t *seqs = malloc(count * sizeof(uint32_t));
+        if (seqs == NULL) {
+            log_error("Failed to allocate %zu sequence numbers.\n", count);
+            goto out_free;
+        }
+        for (size_t i = 0; i < count; i++)
+            seqs[i] = htonl((uint32_t)i);
+        if ((pipeline->seq_mr = dccs_reg_msgs(id, seqs, count * sizeof(uint32_t))) == NULL) {
+            free(seqs);
+            goto out_free;
+        }
     }
 
-    return -failed_count;
+    return 0;
+
+out_free:
+    free(pipeline->wrs);
+    free(pipeline->sges);
+    return -1;
+}
+
+void pipeline_destroy(struct dccs_pipeline *pipeline) {
+    if (pipeline->seq_mr != NULL) {
+        void *seqs = pipeline->seq_mr->addr;
+        rdma_dereg_mr(pipeline->seq_mr);
+        free(seqs);
+    }
+    free(pipeline->wrs);
+    free(pipeline->sges);
+}
+
+static inline bool pipeline_done(struct dccs_pipeline *pipeline) {
+    return pipeline->completed == pipeline->count;
 }
 
 /**
- * Send and wait for multiple RDMA requests.
+ * Post requests until the window is full or all are posted.
  */
-int send_and_wait_requests(struct rdma_cm_id *id, struct dccs_request *requests, struct dccs_parameters *params) {
-    int rv;
-    int failed_count = 0;
-    size_t count = params->count;
-    struct ibv_wc wc;
-    int flags = 0;  // RDMA post signal
+int pipeline_post(struct dccs_pipeline *pipeline) {
+    size_t count = pipeline->count;
+    size_t depth = pipeline->depth;
+
+    while (pipeline->posted < count && pipeline->posted - pipeline->completed < depth) {
+        size_t outstanding = pipeline->posted - pipeline->completed;
+        size_t n = count - pipeline->posted;
+        n = n < pipeline->batch ? n : pipeline->batch;
+        n = n < depth - outstanding ? n : depth - outstanding;
+        if (post_requests(pipeline->id, pipeline->requests, pipeline->posted, n, pipeline->interval, count, pipeline->inline_limit, pipeline->seq_mr, pipeline->wrs, pipeline->sges) != 0) {
+            log_error("Failed to post %zu requests with %zu outstanding.\n", n, outstanding);
+            return -1;
+        }
 
-    switch (params->mode) {
-        case MODE_LATENCY:      // Signal on all requests.
-            flags |= IBV_SEND_SIGNALED;
-            break;
-        case MODE_THROUGHPUT:   // Only signal the last request.
-            flags &= ~IBV_SEND_SIGNALED;
-            break;
+        uint64_t now = get_cycles();
+        for (size_t i = 0; i < n; i++)
+            pipeline->requests[pipeline->posted + i].start = now;
+        pipeline->posted += n;
+        pipeline->doorbells++;
     }
 
-    uint64_t start = get_cycles();
+    return 0;
+}
 
-#if 0
-    // Testing overhead
-    log_debug("Testing overhead of get_cycles().\n");
-    uint64_t *lats = malloc(count * sizeof(uint64_t));
-    for (size_t n = 0; n < count; n++) {
-        lats[n] = get_cycles() - start;
-    }
-    for (size_t n = 0; n < count; n++) {
-        log_debug("n = %zu, clock = %zu.\n", n, lats[n]);
+/**
+ * Reap completions CQ_POLL_BATCH at a time, waiting as set by --completion
+ * if wait is set. Returns the number reaped, or -1 on failure.
+ */
+int pipeline_reap(struct dccs_pipeline *pipeline, bool wait) {
+    struct ibv_wc wcs[CQ_POLL_BATCH];
+
+    int polled = dccs_rdma_reap_send_comps(pipeline->id, wcs, CQ_POLL_BATCH, wait);
+    if (polled <= 0)
+        return polled;
+
+    uint64_t now = get_cycles();
+    for (int i = 0; i < polled; i++) {
+        for (; pipeline->completed <= wcs[i].wr_id; pipeline->completed++)
+            pipeline->requests[pipeline->completed].end = now;
     }
-    log_debug("\n");
-    free(lats);
-#endif
+    pipeline->polls++;
+    pipeline->reaped += polled;
 
-    for (size_t n = 0; n < count; n++) {
-        // In latency test, the tool always uses the same request.
-        // size_t offset = params->mode == MODE_LATENCY ? 0 : n;
-        size_t offset = n;
-        struct dccs_request *request = requests + offset;
-        bool failed = false;
-        if (n == count - 1) {   // Always signal the last request
-            flags |= IBV_SEND_SIGNALED;
-        }
+    return polled;
+}
 
-#if 0
-        log_verbose("buf = %p, length = %zu, remote = %p.\n", request->buf, request->length, request->remote_addr);
-#endif
+/**
+ * Send and wait for multiple RDMA requests on one QP.
+ */
+int send_and_wait_requests(struct rdma_cm_id *id, struct dccs_request *requests, struct dccs_parameters *params) {
+    struct dccs_pipeline pipeline;
+    size_t count = params->count;
+    int rv = 0;
 
-        switch (request->verb) {
-            case Send:
-                rv = dccs_rdma_send_with_flags(id, request->buf, request->length, request->mr, flags);
-                break;
-            case Read:
-                rv = dccs_rdma_read_with_flags(id, request->buf, request->length, request->mr, request->remote_addr, request->remote_rkey, flags);
-                break;
-            case Write:
-                rv = dccs_rdma_write_with_flags(id, request->buf, request->length, request->mr, request->remote_addr, request->remote_rkey, flags);
-                break;
-            default:
-                log_warning("Unrecognized request (n = %zu).", n);
-                rv = 0;
-                break;
-        }
+    if (pipeline_init(&pipeline, id, requests, count, params) != 0)
+        return -1;
 
-        requests[n].start = get_cycles();
-        if (rv != 0)
-            failed = true;
+    uint64_t start = get_cycles();
 
-        if (flags & IBV_SEND_SIGNALED) {
-            rv = dccs_rdma_send_comp(id, &wc);
-            requests[n].end = get_cycles();
-            if (rv < 0)
-                failed = true;
+    while (!pipeline_done(&pipeline)) {
+        if (pipeline_post(&pipeline) != 0) {
+            rv = -1;
+            goto out_destroy;
         }
 
-        if (failed)
-            failed_count++;
+        // The window is full or all is posted, so a signaled request is
+        // outstanding
+        if (pipeline_reap(&pipeline, true) < 0) {
+            rv = -1;
+            goto out_destroy;
+        }
     }
 
     uint64_t end = get_cycles();
@@ -728,34 +1397,191 @@ int send_and_wait_requests(struct rdma_cm_id *id, struct dccs_request *requests,
     }
 #endif
 
-    log_debug("Time elapsed to send and wait all requests: %.3f µsec.\n", (double)(end - start) * 1e6 / (double)clock_rate);
+    log_debug("Time elapsed to send and wait all requests: %.3f µsec, %d doorbells, %d completions in %d polls.\n", (double)(end - start) * 1e6 / (double)clock_rate, pipeline.doorbells, pipeline.reaped, pipeline.polls);
+
+out_destroy:
+    pipeline_destroy(&pipeline);
+    return rv;
+}
+
+/* Multi-QP client */
+
+/**
+ * One client thread of a multi-QP run. It drives qps connections with
+ * count requests each, laid out one connection after the other, from a
+ * core of its own. The QPs' CQs are polled in turn, never waited on.
+ */
+struct dccs_client_thread {
+    pthread_t thread;
+    int index;
+    struct dccs_parameters *params;
+    struct rdma_cm_id **ids;
+    struct dccs_request *requests;
+    size_t qps;
+    size_t count;
+    uint64_t start;
+    uint64_t end;
+    int rv;
+};
+
+void *client_thread_main(void *arg) {
+    struct dccs_client_thread *thread = arg;
+    struct dccs_binding binding;
+    char description[256];
+    size_t qps = thread->qps, done = 0;
+
+    thread->rv = -1;
+    if (affinity_pin(thread->params->pin, thread->params->nic, thread->index, &binding) != 0) {
+        log_perror("Failed to pin CPU");
+        return NULL;
+    }
+    affinity_describe(&binding, description, sizeof(description));
+    log_debug("thread = %d, %s.\n", thread->index, description);
+
+    struct dccs_pipeline *pipelines = calloc(qps, sizeof(struct dccs_pipeline));
+    if (pipelines == NULL) {
+        log_error("Failed to allocate %zu pipelines.\n", qps);
+        return NULL;
+    }
+
+    size_t ready = 0;
+    for (; ready < qps; ready++) {
+        if (pipeline_init(pipelines + ready, thread->ids[ready], thread->requests + ready * thread->count, thread->count, thread->params) != 0)
+            goto out_destroy;
+    }
+
+    thread->start = get_cycles();
+    while (done < qps) {
+        done = 0;
+        for (size_t q = 0; q < qps; q++) {
+            struct dccs_pipeline *pipeline = pipelines + q;
+            if (pipeline_done(pipeline)) {
+                done++;
+                continue;
+            }
+
+            if (pipeline_post(pipeline) != 0 || pipeline_reap(pipeline, false) < 0)
+                goto out_destroy;
+        }
+    }
+    thread->end = get_cycles();
+    thread->rv = 0;
+
+out_destroy:
+    for (size_t q = 0; q < ready; q++)
+        pipeline_destroy(pipelines + q);
+    free(pipelines);
+    return NULL;
+}
+
+/**
+ * Send and wait for all requests over params->threads threads of
+ * params->qps connections each. Connection c carries the c-th slice of
+ * count / (threads * qps) requests. threads holds params->threads entries
+ * that are filled in for print_thread_report().
+ */
+int send_and_wait_requests_threaded(struct rdma_cm_id **ids, struct dccs_request *requests, struct dccs_parameters *params, struct dccs_client_thread *threads) {
+    size_t qps = params->qps;
+    size_t count = params->count / (params->threads * qps);
+    size_t started = 0;
+    int rv = 0;
+
+    for (; started < params->threads; started++) {
+        struct dccs_client_thread *thread = threads + started;
+        memset(thread, 0, sizeof(struct dccs_client_thread));
+        thread->index = (int)started;
+        thread->params = params;
+        thread->ids = ids + started * qps;
+        thread->requests = requests + started * qps * count;
+        thread->qps = qps;
+        thread->count = count;
+        if (pthread_create(&thread->thread, NULL, client_thread_main, thread) != 0) {
+            log_error("Failed to start client thread %zu.\n", started);
+            rv = -1;
+            break;
+        }
+    }
+
+    for (size_t t = 0; t < started; t++) {
+        pthread_join(threads[t].thread, NULL);
+        if (threads[t].rv != 0)
+            rv = -1;
+    }
 
-    return -failed_count;
+    return rv;
 }
 
 /* Reporting functions */
 
-void print_sha1sum(struct dccs_request *requests, size_t count) {
+struct request_checksum_job {
+    struct dccs_request *requests;
+    uint32_t *crcs;
+};
+
+void request_checksum_part(void *arg, size_t begin, size_t end) {
+    struct request_checksum_job *job = arg;
+    for (size_t n = begin; n < end; n++)
+        job->crcs[n] = crc32c(0, job->requests[n].buf, job->requests[n].length);
+}
+
+/**
+ * Compare the CRC32C of every request's buffer with the peer's: the server
+ * sends its checksums to the client, which reports each mismatching
+ * request. Both sides log a checksum over all requests.
+ */
+int verify_request_checksums(struct rdma_cm_id *id, struct dccs_request *requests, struct dccs_parameters *params, Role role) {
+    size_t count = params->count;
+    size_t length = params->length;
+    size_t array_size = count * sizeof(uint32_t);
+    int rv = 0;
+
     if (count == 0) {
-        log_error("Failed to calculate SHA1 sum: empty request array.");
-        return;
+        log_error("Failed to calculate checksums: empty request array.\n");
+        return -1;
     }
 
-    unsigned char digest[SHA_DIGEST_LENGTH];
+    uint32_t *crcs = malloc(2 * array_size);
+    if (crcs == NULL) {
+        log_error("Failed to allocate checksums of %zu requests.\n", count);
+        return -1;
+    }
+
+    uint32_t *remote_crcs = crcs + count;
+    struct request_checksum_job job = { requests, crcs };
+
+    crc32c_init();
+    parallel_ranges(count, HELPER_THREAD_BYTES / length, 1, request_checksum_part, &job);
+    log_info("Checksum: count = %zu, length = %zu, crc32c = %08x.\n", count, length, crc32c(0, crcs, array_size));
 
-    size_t length = requests[0].length;
-    void **array = malloc(count * sizeof(void *));
+    if (role == ROLE_SERVER) {
+        if ((rv = send_message(id, crcs, array_size)) < 0)
+            log_error("Failed to send checksums.\n");
+        goto out_free;
+    }
+
+    if ((rv = recv_message(id, remote_crcs, array_size)) < 0) {
+        log_error("Failed to recv checksums.\n");
+        goto out_free;
+    }
+
+    size_t bad = 0;
     for (size_t n = 0; n < count; n++) {
-        struct dccs_request *request = requests + n;
-        array[n] = request->buf;
+        if (crcs[n] == remote_crcs[n])
+            continue;
+
+        if (bad++ < CHECKSUM_REPORT_LIMIT)
+            log_error("Checksum mismatch: request = %zu, crc32c = %08x, remote = %08x.\n", n, crcs[n], remote_crcs[n]);
     }
 
-    sha1sum_array((const void **)array, count, length, digest);
-    char *digest_hex = bin_to_hex_string(digest, SHA_DIGEST_LENGTH);
-    log_info("SHA1 sum: count = %zu, length = %zu, digest = %s.\n", count, length, digest_hex);
+    if (bad > 0) {
+        log_error("Checksum mismatch: %zu of %zu requests.\n", bad, count);
+        rv = -1;
+    }
 
-    free(digest_hex);
-    free(array);
+out_free:
+    mr_cache_invalidate(crcs, 2 * array_size);
+    free(crcs);
+    return rv;
 }
 
 void print_raw_latencies(double *latencies, size_t count) {
@@ -767,6 +1593,11 @@ void print_raw_latencies(double *latencies, size_t count) {
     log_verbose("\n");
 }
 
+void print_inline_status(struct dccs_parameters *params) {
+    bool sent_inline = params->verb != Read && params->length <= params->inline_limit;
+    log_info("Inline: limit = %zu B, requests %s.\n", params->inline_limit, sent_inline ? "sent inline" : "not inline");
+}
+
 /**
  * Print latency report.
  */
@@ -826,6 +1657,7 @@ void print_latency_report(struct dccs_parameters *params, struct dccs_request *r
     log_info("#bytes, #iterations, median, average, min, max, stdev, percent90, percent99\n");
     log_info("%zu, %zu, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f\n", length, count, median, average, min, max, stdev, percent90, percent99);
     log_info("# of requests sent in %d µsec: %d.\n", DCCS_CYCLE_UPTIME, finished_count);
+    print_inline_status(params);
     log_info("=====================\n\n");
 
     free(latencies);
@@ -845,11 +1677,97 @@ void print_throughput_report(struct dccs_parameters *params, struct dccs_request
     double elapsed_seconds = (double)(end_cycles - start_cycles) / (double)clock_rate;
     double throughput_bytes_per_second = (double)transfered_bytes / elapsed_seconds;
     double throughput_gbits = throughput_bytes_per_second * 8 / 1e9;
+    double message_rate = (double)(count - warmup_count) / elapsed_seconds / 1e6;
 
     log_info("=====================\n");
     log_info("Throughput Report\n");
-    log_info("Transferred: %lu B, elapsed: %.3e s, throughput: %.3f Gbps.\n", transfered_bytes, elapsed_seconds, throughput_gbits);
+    log_info("Transferred: %lu B in %zu B requests, elapsed: %.3e s, throughput: %.3f Gbps.\n", transfered_bytes, length, elapsed_seconds, throughput_gbits);
+    log_info("Depth: %zu, signaled every %zu, posted %zu per doorbell, message rate: %.3f Mmsg/s.\n", params->depth, params->signal_interval, params->post_batch, message_rate);
+    print_inline_status(params);
+    log_info("=====================\n\n");
+}
+
+/**
+ * Print throughput report of a multi-QP run, per thread and in total.
+ * Warmup requests are counted.
+ */
+void print_thread_report(struct dccs_parameters *params, struct dccs_client_thread *threads) {
+    size_t length = params->length;
+    size_t thread_count = params->count / params->threads;
+    uint64_t first = UINT64_MAX, last = 0;
+
+    log_info("=====================\n");
+    log_info("Thread Report\n");
+    log_info("#thread, #qps, #requests, elapsed (s), throughput (Gbps), message rate (Mmsg/s)\n");
+    for (size_t t = 0; t < params->threads; t++) {
+        struct dccs_client_thread *thread = threads + t;
+        double elapsed_seconds = (double)(thread->end - thread->start) / (double)clock_rate;
+        log_info("%d, %zu, %zu, %.3e, %.3f, %.3f\n", thread->index, thread->qps, thread_count, elapsed_seconds,
+            (double)(thread_count * length) * 8 / elapsed_seconds / 1e9, (double)thread_count / elapsed_seconds / 1e6);
+
+        first = thread->start < first ? thread->start : first;
+        last = thread->end > last ? thread->end : last;
+    }
+
+    double elapsed_seconds = (double)(last - first) / (double)clock_rate;
+    log_info("Total: %zu B in %zu B requests over %zu threads x %zu QPs, elapsed: %.3e s, throughput: %.3f Gbps, message rate: %.3f Mmsg/s.\n",
+        params->count * length, length, params->threads, params->qps, elapsed_seconds,
+        (double)(params->count * length) * 8 / elapsed_seconds / 1e9, (double)params->count / elapsed_seconds / 1e6);
+    print_inline_status(params);
     log_info("=====================\n\n");
 }
 
+/**
+ * Print per-client and aggregate throughput of a round served to
+ * params->clients clients by serve_round().
+ */
+void print_client_report(struct dccs_parameters *params, uint64_t *starts, uint64_t *ends) {
+    size_t bytes = params->count * params->length;
+    uint64_t first = UINT64_MAX, last = 0;
+
+    log_info("=====================\n");
+    log_info("Client Report\n");
+    log_info("#client, #requests, elapsed (s), throughput (Gbps)\n");
+    for (size_t c = 0; c < params->clients; c++) {
+        double elapsed_seconds = (double)(ends[c] - starts[c]) / (double)clock_rate;
+        log_info("%zu, %zu, %.3e, %.3f\n", c, params->count, elapsed_seconds, (double)bytes * 8 / elapsed_seconds / 1e9);
+
+        first = starts[c] < first ? starts[c] : first;
+        last = ends[c] > last ? ends[c] : last;
+    }
+
+    double elapsed_seconds = (double)(last - first) / (double)clock_rate;
+    log_info("Aggregate: %zu B from %zu clients in %zu B requests, elapsed: %.3e s, throughput: %.3f Gbps.\n",
+        params->clients * bytes, params->clients, params->length, elapsed_seconds, (double)(params->clients * bytes) * 8 / elapsed_seconds / 1e9);
+    log_info("=====================\n\n");
+}
+
+/**
+ * Print how a round went through the receive ring: its reposts so far,
+ * and for the write variants how many sequence numbers arrived out of
+ * each connection's order.
+ */
+void print_ring_report(struct dccs_recv_ring *ring) {
+    if (ring->verb == Send)
+        log_info("Receive ring: %zu buffers of %zu B per queue, %zu reposts.\n", ring->size, ring->length, ring->reposts);
+    else
+        log_info("Receive ring: %zu buffers of %zu B per queue, %zu reposts, %zu sequence numbers out of order.\n",
+            ring->size, ring->length, ring->reposts, ring->misordered);
+}
+
+/**
+ * Print what the server's connections hold for receiving: a receive queue
+ * and CQ each, or one SRQ and CQ for all, and the receive ring's buffers.
+ */
+void print_recv_resources(struct dccs_parameters *params, size_t connections) {
+    size_t queues = params->srq ? 1 : connections;
+    size_t length = ring_length(params);
+    size_t ring_bytes = uses_recv_ring(params->verb) ? queues * ring_size(length) * length : 0;
+
+    if (params->srq)
+        log_info("Receive resources: 1 SRQ of %d WRs and 1 CQ shared by %zu QPs, %zu B of receive buffers.\n", SRQ_SIZE, connections, ring_bytes);
+    else
+        log_info("Receive resources: %zu receive queues of %d WRs and %zu CQs, %zu B of receive buffers.\n", connections, MAX_WR, connections, ring_bytes);
+}
+
 #endif // DCCS_RDMA_H
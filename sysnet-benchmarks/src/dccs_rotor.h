@@ -0,0 +1,247 @@
+/**
+ * RotorLB engine for DC circuit switch
+ */
+
+#ifndef DCCS_ROTOR_H
+#define DCCS_ROTOR_H
+
+#include "dccs_transport.h"
+
+/* Rotor schedule */
+
+/**
+ * The rotor shift schedule of mpi_main.c and rlb_v1: in slot s, rank r
+ * sends to r + k and receives from r - k, with k cycling through
+ * 1..size-1, so every peer is matched once every size - 1 slots.
+ */
+static inline int rotor_shift(int size, size_t slot) {
+    return (int)(slot % (size_t)(size - 1)) + 1;
+}
+
+static inline int rotor_dest(int size, int rank, size_t slot) {
+    return (rank + rotor_shift(size, slot)) % size;
+}
+
+static inline int rotor_src(int size, int rank, size_t slot) {
+    return (rank - rotor_shift(size, slot) + size) % size;
+}
+
+/**
+ * Slots among the first slots in which peer sends to rank.
+ */
+static inline size_t rotor_slots_from(int size, int rank, int peer, size_t slots) {
+    size_t first = (size_t)((rank - peer + size) % size - 1);
+    return slots > first ? (slots - first + (size_t)size - 2) / (size_t)(size - 1) : 0;
+}
+
+/* Engine */
+
+/**
+ * A rank of a rotor, over any transport. Each peer writes its slot into
+ * its own slot buffer here, with the slot number as the immediate, so a
+ * write both delivers the data and tells us when.
+ */
+struct dccs_rotor {
+    struct dccs_transport *transport;
+    int size;
+    int rank;
+    size_t length;                  // Bytes per slot buffer, the largest length
+    uint8_t *send_buf;              // What we write to every peer
+    int send_handle;
+    uint8_t *recv_bufs;             // Slot buffer of peer p at p * length
+    int recv_handle;
+    size_t *unposted;               // Per peer, notifications of a run still to post receives for
+    size_t *outstanding;            // Per peer, writes not yet completed
+    uint64_t *deliveries;           // Per slot, cycles from its start to its delivery
+    size_t slots;
+    size_t late_posts;              // Writes posted after their slot was over
+    size_t misordered;              // Notifications from another peer than the slot's
+};
+
+#define ROTOR_UNDELIVERED UINT64_MAX
+
+/**
+ * Set up a rotor of every rank of the transport, with slot buffers for
+ * slots of up to params->length_max bytes. Collective.
+ */
+int rotor_init(struct dccs_rotor *rotor, struct dccs_transport *transport, struct dccs_parameters *params) {
+    memset(rotor, 0, sizeof(struct dccs_rotor));
+    rotor->transport = transport;
+    rotor->size = transport->size;
+    rotor->rank = transport->rank;
+    rotor->send_handle = rotor->recv_handle = -1;
+    rotor->length = params->length_max;
+    rotor->unposted = calloc((size_t)rotor->size, sizeof(size_t));
+    rotor->outstanding = calloc((size_t)rotor->size, sizeof(size_t));
+    rotor->send_buf = malloc_payload(rotor->length, params->seed, (uint64_t)rotor->rank, 0);
+    rotor->recv_bufs = calloc((size_t)rotor->size, rotor->length);
+    if (rotor->unposted == NULL || rotor->outstanding == NULL || rotor->send_buf == NULL || rotor->recv_bufs == NULL) {
+        log_error("Failed to allocate a rotor of %d ranks and %zu B slots.\n", rotor->size, rotor->length);
+        return -1;
+    }
+
+    if ((rotor->send_handle = transport_reg(transport, rotor->send_buf, rotor->length)) < 0)
+        return -1;
+    if ((rotor->recv_handle = transport_reg(transport, rotor->recv_bufs, (size_t)rotor->size * rotor->length)) < 0)
+        return -1;
+
+    return 0;
+}
+
+/**
+ * Post up to n of peer's outstanding notification receives. They take no
+ * data: the write itself lands in the slot buffer.
+ */
+int rotor_post_recvs(struct dccs_rotor *rotor, int peer, size_t n) {
+    n = n < rotor->unposted[peer] ? n : rotor->unposted[peer];
+    for (size_t i = 0; i < n; i++) {
+        if (transport_post_recv(rotor->transport, peer, rotor->recv_handle, 0, 0, (uint64_t)peer) != 0)
+            return -1;
+        rotor->unposted[peer]--;
+    }
+
+    return 0;
+}
+
+/**
+ * Reap what completed once: our writes, and the deliveries of the slots
+ * peers write to us, timed from the start of the slot on our clock.
+ */
+int rotor_poll(struct dccs_rotor *rotor, uint64_t start, uint64_t slot_cycles) {
+    struct dccs_completion comps[CQ_POLL_BATCH];
+    int polled = transport_poll(rotor->transport, comps, CQ_POLL_BATCH);
+    uint64_t now = get_cycles();
+
+    if (polled < 0)
+        return -1;
+
+    for (int i = 0; i < polled; i++) {
+        struct dccs_completion *comp = comps + i;
+        if (comp->op == TRANSPORT_OP_WRITE) {
+            rotor->outstanding[comp->peer]--;
+            continue;
+        }
+        if (comp->op != TRANSPORT_OP_NOTIFY || comp->imm >= rotor->slots) {
+            log_error("Unexpected completion %d of slot %u from rank %d.\n", comp->op, comp->imm, comp->peer);
+            return -1;
+        }
+
+        uint64_t slot_start = start + comp->imm * slot_cycles;
+        rotor->deliveries[comp->imm] = now > slot_start ? now - slot_start : 0;
+        if (comp->peer != rotor_src(rotor->size, rotor->rank, comp->imm))
+            rotor->misordered++;
+        if (rotor_post_recvs(rotor, comp->peer, 1) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Run slots rotor slots of params->length bytes from start on our clock.
+ * Slot s starts at start + s slots, however late the previous one ran:
+ * its write goes out to rotor_dest() and then we wait for the write from
+ * rotor_src(), timing its delivery from the slot's start. Transports that
+ * only move data when polled are polled all along.
+ */
+int rotor_run(struct dccs_rotor *rotor, struct dccs_parameters *params, uint64_t start, size_t slots) {
+    uint64_t slot_cycles = params->slot_us * clock_rate / MILLION;
+
+    free(rotor->deliveries);
+    if ((rotor->deliveries = malloc(slots * sizeof(uint64_t))) == NULL) {
+        log_error("Failed to allocate a run of %zu slots.\n", slots);
+        return -1;
+    }
+    for (size_t s = 0; s < slots; s++)
+        rotor->deliveries[s] = ROTOR_UNDELIVERED;
+    rotor->slots = slots;
+    rotor->late_posts = rotor->misordered = 0;
+
+    for (int peer = 0; peer < rotor->size; peer++) {
+        if (peer == rotor->rank)
+            continue;
+        rotor->unposted[peer] = rotor_slots_from(rotor->size, rotor->rank, peer, slots);
+        if (rotor_post_recvs(rotor, peer, ROTOR_RECV_DEPTH) != 0)
+            return -1;
+    }
+
+    for (size_t s = 0; s < slots; s++) {
+        int dest = rotor_dest(rotor->size, rotor->rank, s);
+        uint64_t slot_start = start + s * slot_cycles;
+
+        while (get_cycles() < slot_start) {
+            if (rotor_poll(rotor, start, slot_cycles) != 0)
+                return -1;
+        }
+        if (get_cycles() >= slot_start + slot_cycles)
+            rotor->late_posts++;
+
+        // Keep room in the send queue of a peer matched every size - 1 slots
+        while (rotor->outstanding[dest] == TRANSPORT_QUEUE_DEPTH) {
+            if (rotor_poll(rotor, start, slot_cycles) != 0)
+                return -1;
+        }
+
+        if (transport_post_write(rotor->transport, dest, rotor->send_handle, 0, params->length,
+                rotor->recv_handle, (size_t)rotor->rank * rotor->length, (uint32_t)s, s) != 0) {
+            log_error("Failed to post the write of slot %zu to rank %d.\n", s, dest);
+            return -1;
+        }
+        rotor->outstanding[dest]++;
+
+        while (rotor->deliveries[s] == ROTOR_UNDELIVERED) {
+            if (rotor_poll(rotor, start, slot_cycles) != 0)
+                return -1;
+        }
+    }
+
+    // Every write is known delivered, but its completion may still be due
+    for (int peer = 0; peer < rotor->size; peer++) {
+        while (rotor->outstanding[peer] > 0) {
+            if (rotor_poll(rotor, start, slot_cycles) != 0)
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Check every peer's slot buffer against what it writes, after a run of
+ * params->length bytes in which it was matched with us. Returns the number
+ * of mismatching peers.
+ */
+size_t rotor_verify(struct dccs_rotor *rotor, struct dccs_parameters *params) {
+    size_t bad = 0;
+
+    for (int peer = 0; peer < rotor->size; peer++) {
+        if (peer == rotor->rank || rotor_slots_from(rotor->size, rotor->rank, peer, rotor->slots) == 0)
+            continue;
+
+        size_t mismatch = verify_payload(rotor->recv_bufs + (size_t)peer * rotor->length, params->length, params->seed, (uint64_t)peer, 0);
+        if (mismatch != params->length) {
+            log_error("rank = %d, slot buffer of rank %d mismatches at byte %zu of %zu.\n", rotor->rank, peer, mismatch, params->length);
+            bad++;
+        }
+    }
+
+    return bad;
+}
+
+/**
+ * Release the slot buffers. Collective, like rotor_init().
+ */
+void rotor_destroy(struct dccs_rotor *rotor) {
+    if (rotor->transport != NULL) {
+        transport_dereg(rotor->transport, rotor->send_handle);
+        transport_dereg(rotor->transport, rotor->recv_handle);
+    }
+    free(rotor->send_buf);
+    free(rotor->recv_bufs);
+    free(rotor->unposted);
+    free(rotor->outstanding);
+    free(rotor->deliveries);
+    memset(rotor, 0, sizeof(struct dccs_rotor));
+}
+
+#endif // DCCS_ROTOR_H
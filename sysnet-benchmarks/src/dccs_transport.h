@@ -0,0 +1,305 @@
+/**
+ * Transport abstraction for DC circuit switch
+ */
+
+#ifndef DCCS_TRANSPORT_H
+#define DCCS_TRANSPORT_H
+
+#include "dccs_mpi.h"
+#include "dccs_utils.h"
+
+/**
+ * The operations a benchmark is written against, after verbs: sends are
+ * matched with the receives a peer posted for us, in the order they were
+ * posted, and writes land in a peer's registered buffer and then consume
+ * its next receive to tell it so, like RDMA_WRITE_WITH_IMM. Every
+ * operation completes once, through transport_poll(). Ranks are set up
+ * through MPI_COMM_WORLD, whatever carries the data.
+ */
+typedef enum {
+    TRANSPORT_OP_SEND,      // Our send went out, its buffer is free again
+    TRANSPORT_OP_RECV,      // A posted receive took in a send
+    TRANSPORT_OP_WRITE,     // Our write went out, its buffer is free again
+    TRANSPORT_OP_NOTIFY,    // A posted receive took in the notification of a write
+} TransportOp;
+
+struct dccs_completion {
+    TransportOp op;
+    int peer;
+    uint64_t id;        // As posted, the receive's for RECV and NOTIFY
+    size_t length;      // Bytes received or written, for RECV and NOTIFY
+    uint32_t imm;       // Immediate of a NOTIFY
+};
+
+struct dccs_transport;
+
+struct dccs_transport_ops {
+    const char *name;
+    int (*init)(struct dccs_transport *transport, struct dccs_parameters *params);
+    void (*destroy)(struct dccs_transport *transport);
+    int (*reg)(struct dccs_transport *transport, int handle);
+    void (*dereg)(struct dccs_transport *transport, int handle);
+    int (*post_send)(struct dccs_transport *transport, int peer, int handle, size_t offset, size_t length, uint64_t id);
+    int (*post_recv)(struct dccs_transport *transport, int peer, int handle, size_t offset, size_t length, uint64_t id);
+    int (*post_write)(struct dccs_transport *transport, int peer, int handle, size_t offset, size_t length,
+        int remote_handle, size_t remote_offset, uint32_t imm, uint64_t id);
+    int (*poll)(struct dccs_transport *transport, struct dccs_completion *comps, int max);
+};
+
+/**
+ * A rank's end of a transport. Buffers are named by handles, which every
+ * rank hands out in the same order, so a write names its target buffer by
+ * our handle for the matching one.
+ */
+struct dccs_transport {
+    const struct dccs_transport_ops *ops;
+    int size;
+    int rank;
+    size_t inline_limit;                        // Inline data of verbs, 0 elsewhere
+    uint8_t *bufs[TRANSPORT_MAX_BUFFERS];       // Per handle, NULL when free
+    size_t lengths[TRANSPORT_MAX_BUFFERS];
+    void *state;                                // The backend's
+};
+
+/**
+ * Register length bytes at addr for every operation. Collective: every rank
+ * registers its buffers in the same order. Returns the handle, or -1.
+ */
+int transport_reg(struct dccs_transport *transport, void *addr, size_t length) {
+    int handle = 0;
+
+    while (handle < TRANSPORT_MAX_BUFFERS && transport->bufs[handle] != NULL)
+        handle++;
+    if (handle == TRANSPORT_MAX_BUFFERS) {
+        log_error("No more than %d buffers can be registered with a transport.\n", TRANSPORT_MAX_BUFFERS);
+        return -1;
+    }
+
+    transport->bufs[handle] = addr;
+    transport->lengths[handle] = length;
+    if (transport->ops->reg(transport, handle) != 0) {
+        log_error("Failed to register %zu B with the %s transport.\n", length, transport->ops->name);
+        transport->bufs[handle] = NULL;
+        return -1;
+    }
+
+    return handle;
+}
+
+/**
+ * Deregister a buffer. Collective, like transport_reg().
+ */
+void transport_dereg(struct dccs_transport *transport, int handle) {
+    if (handle < 0 || handle >= TRANSPORT_MAX_BUFFERS || transport->bufs[handle] == NULL)
+        return;
+
+    transport->ops->dereg(transport, handle);
+    transport->bufs[handle] = NULL;
+    transport->lengths[handle] = 0;
+}
+
+static inline bool transport_valid(struct dccs_transport *transport, int peer, int handle, size_t offset, size_t length) {
+    if (peer < 0 || peer >= transport->size || peer == transport->rank) {
+        log_error("Invalid peer %d of rank %d.\n", peer, transport->rank);
+        return false;
+    }
+    if (handle < 0 || handle >= TRANSPORT_MAX_BUFFERS || transport->bufs[handle] == NULL
+            || offset > transport->lengths[handle] || length > transport->lengths[handle] - offset) {
+        log_error("%zu B at offset %zu are out of buffer %d.\n", length, offset, handle);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Send length bytes at offset of buffer handle to peer.
+ */
+static inline int transport_post_send(struct dccs_transport *transport, int peer, int handle, size_t offset, size_t length, uint64_t id) {
+    if (!transport_valid(transport, peer, handle, offset, length))
+        return -1;
+
+    return transport->ops->post_send(transport, peer, handle, offset, length, id);
+}
+
+/**
+ * Post a receive of up to length bytes from peer at offset of buffer
+ * handle. A receive only for notifications may have no length.
+ */
+static inline int transport_post_recv(struct dccs_transport *transport, int peer, int handle, size_t offset, size_t length, uint64_t id) {
+    if (!transport_valid(transport, peer, handle, offset, length))
+        return -1;
+
+    return transport->ops->post_recv(transport, peer, handle, offset, length, id);
+}
+
+/**
+ * Write length bytes at offset of buffer handle to remote_offset of peer's
+ * buffer remote_handle, and notify peer with imm.
+ */
+static inline int transport_post_write(struct dccs_transport *transport, int peer, int handle, size_t offset, size_t length,
+        int remote_handle, size_t remote_offset, uint32_t imm, uint64_t id) {
+    if (!transport_valid(transport, peer, handle, offset, length))
+        return -1;
+
+    return transport->ops->post_write(transport, peer, handle, offset, length, remote_handle, remote_offset, imm, id);
+}
+
+/**
+ * Make progress and reap up to max completions without blocking. Returns
+ * their number, or -1 on a failed operation.
+ */
+static inline int transport_poll(struct dccs_transport *transport, struct dccs_completion *comps, int max) {
+    return transport->ops->poll(transport, comps, max);
+}
+
+/* Backends */
+
+#include "dccs_transport_mpi.h"
+#include "dccs_transport_verbs.h"
+#include "dccs_transport_stream.h"
+
+/**
+ * Set up the transport params->transport names between all ranks of
+ * MPI_COMM_WORLD. Collective.
+ */
+int transport_init(struct dccs_transport *transport, struct dccs_parameters *params) {
+    memset(transport, 0, sizeof(struct dccs_transport));
+    MPI_Comm_size(MPI_COMM_WORLD, &transport->size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &transport->rank);
+
+    switch (params->transport) {
+        case TRANSPORT_MPI:
+            transport->ops = &mpi_transport_ops;
+            break;
+        case TRANSPORT_VERBS:
+            transport->ops = &verbs_transport_ops;
+            break;
+        case TRANSPORT_SHM:
+            transport->ops = &shm_transport_ops;
+            break;
+        case TRANSPORT_TCP:
+            transport->ops = &tcp_transport_ops;
+            break;
+        default:
+            log_error("Unknown transport %d.\n", params->transport);
+            return -1;
+    }
+
+    if (transport->ops->init(transport, params) != 0) {
+        log_error("rank = %d, failed to set up the %s transport.\n", transport->rank, transport->ops->name);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Tear the transport down, with every buffer still registered. Collective:
+ * peers may still be reaping what we sent them until every rank is here.
+ */
+void transport_destroy(struct dccs_transport *transport) {
+    if (transport->ops == NULL)
+        return;
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    for (int handle = 0; handle < TRANSPORT_MAX_BUFFERS; handle++)
+        transport_dereg(transport, handle);
+    transport->ops->destroy(transport);
+    memset(transport, 0, sizeof(struct dccs_transport));
+}
+
+/* Tools */
+
+/**
+ * A benchmark over the transport. init sets up its state once the
+ * transport is up, run takes it through one length of a --length-range
+ * sweep, and finish reports on the sweep and releases the state. Buffers
+ * are sized for the largest length. init and run are collective; run
+ * returns -1 if it failed, which aborts every rank, and 1 if it completed
+ * with errors such as data that did not verify.
+ */
+struct dccs_transport_tool {
+    const char *name;
+    int (*check)(struct dccs_parameters *params);   // Before MPI is up, may be NULL
+    int (*init)(struct dccs_transport *transport, struct dccs_parameters *params, void *state);
+    int (*run)(struct dccs_transport *transport, struct dccs_parameters *params, void *state);
+    void (*finish)(struct dccs_transport *transport, struct dccs_parameters *params, void *state);
+};
+
+/**
+ * Set up the transport and the tool, or abort every rank, as the others
+ * would wait on one that failed. Then run the sweep and tear down.
+ */
+int transport_tool_run(const struct dccs_transport_tool *tool, void *state, struct dccs_parameters *params) {
+    struct dccs_transport transport;
+    int size, rank, rv = 0;
+
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (size < 2) {
+        log_error("A %s needs at least 2 ranks.\n", tool->name);
+        return -1;
+    }
+
+    if (transport_init(&transport, params) != 0) {
+        log_error("rank = %d, failed to set up the transport.\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (rank == 0)
+        log_info("%d ranks connected over %s, inline data up to %zu B.\n", size, transport.ops->name, transport.inline_limit);
+    if (tool->init(&transport, params, state) != 0) {
+        log_error("rank = %d, failed to set up the %s.\n", rank, tool->name);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+
+    for (size_t length = params->length_min; length != 0; length = next_length(params, length)) {
+        params->length = length;
+        int result = tool->run(&transport, params, state);
+        if (result < 0) {
+            log_error("rank = %d, %s run of %zu B failed.\n", rank, tool->name, length);
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        if (result > 0)
+            rv = -1;
+    }
+
+    // Peers may still be reaping their last writes to us
+    MPI_Barrier(MPI_COMM_WORLD);
+    tool->finish(&transport, params, state);
+    transport_destroy(&transport);
+    return rv;
+}
+
+/**
+ * The main() of a tool over the transport, with MPI around it.
+ */
+int transport_tool_main(int argc, char *argv[], const struct dccs_transport_tool *tool, void *state) {
+    struct dccs_parameters params;
+    int rank, rv;
+
+    parse_args(argc, argv, &params);
+    if (params.window > TRANSPORT_QUEUE_DEPTH) {
+        log_error("window must be at most the transport queue depth of %d.\n", TRANSPORT_QUEUE_DEPTH);
+        return EXIT_FAILURE;
+    }
+    if (tool->check != NULL && tool->check(&params) != 0) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    print_parameters(&params);
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    dccs_init(&params, rank, affinity_local_rank(MPI_COMM_WORLD));
+    dccs_cq_wait_init(&params);
+
+    rv = transport_tool_run(tool, state, &params);
+
+    MPI_Finalize();
+
+    return rv == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif // DCCS_TRANSPORT_H
@@ -0,0 +1,333 @@
+/**
+ * MPI transport for DC circuit switch
+ */
+
+#ifndef DCCS_TRANSPORT_MPI_H
+#define DCCS_TRANSPORT_MPI_H
+
+#include "dccs_transport.h"
+
+#define TRANSPORT_TAG_SEND 1
+#define TRANSPORT_TAG_WRITE 2           // The header of a write
+#define TRANSPORT_TAG_WRITE_DATA 3      // Its data, right behind it
+
+/**
+ * Where a write goes, sent ahead of its data like the stream backend's
+ * frame header. MPI keeps messages between two ranks in order, so the data
+ * is the next one from that peer and is received straight into place.
+ */
+struct dccs_mpi_header {
+    uint64_t offset;
+    uint64_t length;
+    uint32_t imm;
+    int32_t handle;
+};
+
+struct dccs_mpi_recv {
+    int handle;
+    size_t offset;
+    size_t length;
+    uint64_t id;
+};
+
+/**
+ * Sends, writes and matched receives run in a request pool of twice
+ * params->window operations, as a write takes one for its header and one
+ * for its data. Posted receives wait per peer until a message from that
+ * peer is probed, so they are matched in order whatever its tag.
+ */
+struct dccs_mpi_transport {
+    struct dccs_request_pool pool;
+    struct dccs_completion *pending;        // Per pool slot, what its operation completes
+    struct dccs_mpi_header *headers;        // Per pool slot, the header of a write sent
+    bool *silent;                           // Per pool slot, whether it completes nothing
+    struct dccs_mpi_header *incoming;       // Per peer, the header of a write whose data is next
+    bool *incoming_data;
+    struct dccs_completion *ready;          // Completed, not yet polled
+    size_t ready_first;
+    size_t ready_count;
+    size_t ready_capacity;
+    struct dccs_mpi_recv *recvs;            // Per peer, a ring of TRANSPORT_QUEUE_DEPTH posted receives
+    size_t *recv_head;
+    size_t *recv_count;
+    MPI_Comm comm;                          // Ours, so no other message is probed as a receive
+};
+
+static int mpi_push_ready(struct dccs_mpi_transport *mpi, struct dccs_completion *comp) {
+    if (mpi->ready_first + mpi->ready_count == mpi->ready_capacity) {
+        if (mpi->ready_first > 0) {
+            memmove(mpi->ready, mpi->ready + mpi->ready_first, mpi->ready_count * sizeof(struct dccs_completion));
+            mpi->ready_first = 0;
+        } else {
+            size_t capacity = 2 * mpi->ready_capacity;
+            struct dccs_completion *ready = realloc(mpi->ready, capacity * sizeof(struct dccs_completion));
+            if (ready == NULL) {
+                log_error("Failed to queue %zu completions.\n", capacity);
+                return -1;
+            }
+            mpi->ready = ready;
+            mpi->ready_capacity = capacity;
+        }
+    }
+
+    mpi->ready[mpi->ready_first + mpi->ready_count++] = *comp;
+    return 0;
+}
+
+/**
+ * Move the operations of the pool that completed to the ready queue.
+ */
+static int mpi_reap(struct dccs_mpi_transport *mpi) {
+    int completed = request_pool_progress(&mpi->pool);
+
+    for (int i = 0; i < completed; i++) {
+        int slot = mpi->pool.indices[i];
+        if (!mpi->silent[slot] && mpi_push_ready(mpi, mpi->pending + slot) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Get a pool slot, keeping what completes while waiting for one.
+ */
+static int mpi_get_slot(struct dccs_mpi_transport *mpi, MPI_Request **request) {
+    while (request_pool_full(&mpi->pool)) {
+        if (mpi_reap(mpi) != 0)
+            return -1;
+    }
+
+    *request = request_pool_get(&mpi->pool);
+    int slot = (int)(*request - mpi->pool.requests);
+    mpi->silent[slot] = false;
+    return slot;
+}
+
+/**
+ * Take in the header of a write from peer, and check where it goes.
+ */
+static int mpi_recv_header(struct dccs_transport *transport, int peer, MPI_Message *message) {
+    struct dccs_mpi_transport *mpi = transport->state;
+    struct dccs_mpi_header *header = mpi->incoming + peer;
+
+    MPI_Mrecv(header, sizeof(struct dccs_mpi_header), MPI_BYTE, message, MPI_STATUS_IGNORE);
+    if (header->handle < 0 || header->handle >= TRANSPORT_MAX_BUFFERS || transport->bufs[header->handle] == NULL
+            || header->offset + header->length > transport->lengths[header->handle]) {
+        log_error("A write of %lu B from rank %d to offset %lu overflows buffer %d.\n", header->length, peer, header->offset, header->handle);
+        return -1;
+    }
+    mpi->incoming_data[peer] = true;
+
+    return 0;
+}
+
+/**
+ * Match the messages that arrived from each peer with its posted receives.
+ */
+static int mpi_match(struct dccs_transport *transport) {
+    struct dccs_mpi_transport *mpi = transport->state;
+    MPI_Message message;
+    MPI_Status status;
+    MPI_Request *request;
+    int flag, count, slot;
+
+    for (int peer = 0; peer < transport->size; peer++) {
+        while (mpi->recv_count[peer] > 0 && !request_pool_full(&mpi->pool)) {
+            // The data of a write whose header came in, or the next message
+            MPI_Improbe(peer, mpi->incoming_data[peer] ? TRANSPORT_TAG_WRITE_DATA : MPI_ANY_TAG, mpi->comm, &flag, &message, &status);
+            if (!flag)
+                break;
+            if (status.MPI_TAG == TRANSPORT_TAG_WRITE) {
+                if (mpi_recv_header(transport, peer, &message) != 0)
+                    return -1;
+                continue;
+            }
+
+            struct dccs_mpi_recv *recv = mpi->recvs + (size_t)peer * TRANSPORT_QUEUE_DEPTH + mpi->recv_head[peer];
+            mpi->recv_head[peer] = (mpi->recv_head[peer] + 1) % TRANSPORT_QUEUE_DEPTH;
+            mpi->recv_count[peer]--;
+            if ((slot = mpi_get_slot(mpi, &request)) < 0)
+                return -1;
+
+            struct dccs_completion *comp = mpi->pending + slot;
+            memset(comp, 0, sizeof(struct dccs_completion));
+            comp->peer = peer;
+            comp->id = recv->id;
+            if (status.MPI_TAG == TRANSPORT_TAG_WRITE_DATA) {
+                struct dccs_mpi_header *header = mpi->incoming + peer;
+                mpi->incoming_data[peer] = false;
+                comp->op = TRANSPORT_OP_NOTIFY;
+                comp->length = header->length;
+                comp->imm = header->imm;
+                MPI_Imrecv(transport->bufs[header->handle] + header->offset, (int)header->length, MPI_BYTE, &message, request);
+                continue;
+            }
+
+            MPI_Get_count(&status, MPI_BYTE, &count);
+            if ((size_t)count > recv->length) {
+                log_error("A send of %d B from rank %d overflows a receive of %zu B.\n", count, peer, recv->length);
+                return -1;
+            }
+            comp->op = TRANSPORT_OP_RECV;
+            comp->length = (size_t)count;
+            MPI_Imrecv(transport->bufs[recv->handle] + recv->offset, count, MPI_BYTE, &message, request);
+        }
+    }
+
+    return 0;
+}
+
+int mpi_transport_init(struct dccs_transport *transport, struct dccs_parameters *params) {
+    struct dccs_mpi_transport *mpi = calloc(1, sizeof(struct dccs_mpi_transport));
+
+    if ((transport->state = mpi) == NULL)
+        return -1;
+    if (MPI_Comm_dup(MPI_COMM_WORLD, &mpi->comm) != MPI_SUCCESS) {
+        mpi->comm = MPI_COMM_NULL;
+        return -1;
+    }
+    if (request_pool_init(&mpi->pool, 2 * params->window) != 0)
+        return -1;
+    mpi->pending = calloc(2 * params->window, sizeof(struct dccs_completion));
+    mpi->headers = calloc(2 * params->window, sizeof(struct dccs_mpi_header));
+    mpi->silent = calloc(2 * params->window, sizeof(bool));
+    mpi->incoming = calloc((size_t)transport->size, sizeof(struct dccs_mpi_header));
+    mpi->incoming_data = calloc((size_t)transport->size, sizeof(bool));
+    mpi->ready_capacity = params->window;
+    mpi->ready = malloc(mpi->ready_capacity * sizeof(struct dccs_completion));
+    mpi->recvs = malloc((size_t)transport->size * TRANSPORT_QUEUE_DEPTH * sizeof(struct dccs_mpi_recv));
+    mpi->recv_head = calloc((size_t)transport->size, sizeof(size_t));
+    mpi->recv_count = calloc((size_t)transport->size, sizeof(size_t));
+    if (mpi->pending == NULL || mpi->headers == NULL || mpi->silent == NULL || mpi->incoming == NULL
+            || mpi->incoming_data == NULL || mpi->ready == NULL || mpi->recvs == NULL
+            || mpi->recv_head == NULL || mpi->recv_count == NULL) {
+        log_error("Failed to allocate the MPI transport of %d ranks.\n", transport->size);
+        return -1;
+    }
+
+    return 0;
+}
+
+void mpi_transport_destroy(struct dccs_transport *transport) {
+    struct dccs_mpi_transport *mpi = transport->state;
+
+    if (mpi == NULL)
+        return;
+    if (mpi->pool.requests != NULL) {
+        request_pool_drain(&mpi->pool);
+        request_pool_destroy(&mpi->pool);
+    }
+    if (mpi->comm != MPI_COMM_NULL)
+        MPI_Comm_free(&mpi->comm);
+    free(mpi->pending);
+    free(mpi->headers);
+    free(mpi->silent);
+    free(mpi->incoming);
+    free(mpi->incoming_data);
+    free(mpi->ready);
+    free(mpi->recvs);
+    free(mpi->recv_head);
+    free(mpi->recv_count);
+    free(mpi);
+}
+
+/**
+ * Writes are received into the buffer by handle, there is nothing to set up.
+ */
+int mpi_transport_reg(struct dccs_transport *transport, int handle) {
+    (void)transport;
+    (void)handle;
+    return 0;
+}
+
+void mpi_transport_dereg(struct dccs_transport *transport, int handle) {
+    (void)transport;
+    (void)handle;
+}
+
+int mpi_transport_post_send(struct dccs_transport *transport, int peer, int handle, size_t offset, size_t length, uint64_t id) {
+    struct dccs_mpi_transport *mpi = transport->state;
+    MPI_Request *request;
+    int slot;
+
+    if ((slot = mpi_get_slot(mpi, &request)) < 0)
+        return -1;
+    mpi->pending[slot] = (struct dccs_completion){ .op = TRANSPORT_OP_SEND, .peer = peer, .id = id };
+    MPI_Isend(transport->bufs[handle] + offset, (int)length, MPI_BYTE, peer, TRANSPORT_TAG_SEND, mpi->comm, request);
+
+    return 0;
+}
+
+int mpi_transport_post_recv(struct dccs_transport *transport, int peer, int handle, size_t offset, size_t length, uint64_t id) {
+    struct dccs_mpi_transport *mpi = transport->state;
+
+    if (mpi->recv_count[peer] == TRANSPORT_QUEUE_DEPTH) {
+        log_error("More than %d receives posted for rank %d.\n", TRANSPORT_QUEUE_DEPTH, peer);
+        return -1;
+    }
+
+    size_t tail = (mpi->recv_head[peer] + mpi->recv_count[peer]++) % TRANSPORT_QUEUE_DEPTH;
+    mpi->recvs[(size_t)peer * TRANSPORT_QUEUE_DEPTH + tail] = (struct dccs_mpi_recv){ handle, offset, length, id };
+
+    return 0;
+}
+
+/**
+ * Send the header and then the data, which completes the write.
+ */
+int mpi_transport_post_write(struct dccs_transport *transport, int peer, int handle, size_t offset, size_t length,
+        int remote_handle, size_t remote_offset, uint32_t imm, uint64_t id) {
+    struct dccs_mpi_transport *mpi = transport->state;
+    MPI_Request *request;
+    int slot;
+
+    if (remote_handle < 0 || remote_handle >= TRANSPORT_MAX_BUFFERS || transport->bufs[remote_handle] == NULL) {
+        log_error("Invalid remote buffer %d.\n", remote_handle);
+        return -1;
+    }
+
+    if ((slot = mpi_get_slot(mpi, &request)) < 0)
+        return -1;
+    mpi->silent[slot] = true;
+    mpi->headers[slot] = (struct dccs_mpi_header){ remote_offset, length, imm, remote_handle };
+    MPI_Isend(mpi->headers + slot, sizeof(struct dccs_mpi_header), MPI_BYTE, peer, TRANSPORT_TAG_WRITE, mpi->comm, request);
+
+    if ((slot = mpi_get_slot(mpi, &request)) < 0)
+        return -1;
+    mpi->pending[slot] = (struct dccs_completion){ .op = TRANSPORT_OP_WRITE, .peer = peer, .id = id };
+    MPI_Isend(transport->bufs[handle] + offset, (int)length, MPI_BYTE, peer, TRANSPORT_TAG_WRITE_DATA, mpi->comm, request);
+
+    return 0;
+}
+
+int mpi_transport_poll(struct dccs_transport *transport, struct dccs_completion *comps, int max) {
+    struct dccs_mpi_transport *mpi = transport->state;
+    int n = 0;
+
+    if (mpi_match(transport) != 0 || mpi_reap(mpi) != 0)
+        return -1;
+
+    for (; n < max && mpi->ready_count > 0; n++) {
+        comps[n] = mpi->ready[mpi->ready_first++];
+        mpi->ready_count--;
+    }
+    if (mpi->ready_count == 0)
+        mpi->ready_first = 0;
+
+    return n;
+}
+
+const struct dccs_transport_ops mpi_transport_ops = {
+    .name = "mpi",
+    .init = mpi_transport_init,
+    .destroy = mpi_transport_destroy,
+    .reg = mpi_transport_reg,
+    .dereg = mpi_transport_dereg,
+    .post_send = mpi_transport_post_send,
+    .post_recv = mpi_transport_post_recv,
+    .post_write = mpi_transport_post_write,
+    .poll = mpi_transport_poll,
+};
+
+#endif // DCCS_TRANSPORT_MPI_H
@@ -0,0 +1,627 @@
+/**
+ * Byte stream transports for DC circuit switch: shared memory and TCP
+ */
+
+#ifndef DCCS_TRANSPORT_STREAM_H
+#define DCCS_TRANSPORT_STREAM_H
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "dccs_rdma.h"
+#include "dccs_transport.h"
+
+/* Frames */
+
+/**
+ * What precedes the data of a send or a write on a stream, in network byte
+ * order. A write names its target buffer; a send goes where the next
+ * receive posted for us says.
+ */
+struct dccs_frame {
+    uint32_t op;        // TRANSPORT_OP_SEND or TRANSPORT_OP_WRITE
+    uint32_t imm;
+    uint32_t handle;    // Target buffer of a write
+    uint32_t reserved;
+    uint64_t offset;    // Target offset of a write
+    uint64_t length;
+};
+
+struct dccs_stream_op {
+    TransportOp op;
+    int handle;
+    size_t offset;
+    size_t length;
+    int remote_handle;
+    size_t remote_offset;
+    uint32_t imm;
+    uint64_t id;
+};
+
+/**
+ * One peer's end of a stream: sends and writes go out whole and in order,
+ * and every incoming frame takes the next posted receive, so a frame is
+ * only read once there is one.
+ */
+struct dccs_stream_peer {
+    struct dccs_stream_op *sends;   // Ring of TRANSPORT_QUEUE_DEPTH sends and writes
+    size_t send_head;
+    size_t send_count;
+    struct dccs_frame send_frame;   // Header of the first send
+    size_t send_done;               // Bytes of its frame written
+    struct dccs_stream_op *recvs;   // Ring of TRANSPORT_QUEUE_DEPTH posted receives
+    size_t recv_head;
+    size_t recv_count;
+    struct dccs_frame recv_frame;   // Header of the incoming frame
+    size_t recv_done;               // Bytes of it read
+};
+
+/**
+ * Move what can be moved of length bytes to or from peer without blocking.
+ * Returns the bytes moved, or -1 on error.
+ */
+typedef ssize_t (*stream_write_fn)(struct dccs_transport *transport, int peer, const void *buf, size_t length);
+typedef ssize_t (*stream_read_fn)(struct dccs_transport *transport, int peer, void *buf, size_t length);
+
+/**
+ * The frame engine of a byte stream backend, the first member of its state.
+ */
+struct dccs_stream {
+    struct dccs_stream_peer *peers;
+    stream_write_fn write;
+    stream_read_fn read;
+    int next_peer;      // Where polling resumes
+};
+
+static inline struct dccs_stream_peer *stream_peer(struct dccs_transport *transport, int peer) {
+    return ((struct dccs_stream *)transport->state)->peers + peer;
+}
+
+int stream_init(struct dccs_transport *transport, stream_write_fn write, stream_read_fn read) {
+    struct dccs_stream *stream = transport->state;
+
+    stream->write = write;
+    stream->read = read;
+    if ((stream->peers = calloc((size_t)transport->size, sizeof(struct dccs_stream_peer))) == NULL)
+        return -1;
+    for (int peer = 0; peer < transport->size; peer++) {
+        stream->peers[peer].sends = malloc(TRANSPORT_QUEUE_DEPTH * sizeof(struct dccs_stream_op));
+        stream->peers[peer].recvs = malloc(TRANSPORT_QUEUE_DEPTH * sizeof(struct dccs_stream_op));
+        if (stream->peers[peer].sends == NULL || stream->peers[peer].recvs == NULL) {
+            log_error("Failed to allocate the stream queues of %d ranks.\n", transport->size);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void stream_destroy(struct dccs_transport *transport) {
+    struct dccs_stream *stream = transport->state;
+
+    for (int peer = 0; stream->peers != NULL && peer < transport->size; peer++) {
+        free(stream->peers[peer].sends);
+        free(stream->peers[peer].recvs);
+    }
+    free(stream->peers);
+}
+
+static int stream_enqueue(struct dccs_stream_op *ring, size_t head, size_t *count, struct dccs_stream_op *op, int peer) {
+    if (*count == TRANSPORT_QUEUE_DEPTH) {
+        log_error("More than %d operations queued for rank %d.\n", TRANSPORT_QUEUE_DEPTH, peer);
+        return -1;
+    }
+
+    ring[(head + (*count)++) % TRANSPORT_QUEUE_DEPTH] = *op;
+    return 0;
+}
+
+int stream_post_send(struct dccs_transport *transport, int peer, int handle, size_t offset, size_t length, uint64_t id) {
+    struct dccs_stream_peer *p = stream_peer(transport, peer);
+    struct dccs_stream_op op = { .op = TRANSPORT_OP_SEND, .handle = handle, .offset = offset, .length = length, .id = id };
+
+    return stream_enqueue(p->sends, p->send_head, &p->send_count, &op, peer);
+}
+
+int stream_post_recv(struct dccs_transport *transport, int peer, int handle, size_t offset, size_t length, uint64_t id) {
+    struct dccs_stream_peer *p = stream_peer(transport, peer);
+    struct dccs_stream_op op = { .op = TRANSPORT_OP_RECV, .handle = handle, .offset = offset, .length = length, .id = id };
+
+    return stream_enqueue(p->recvs, p->recv_head, &p->recv_count, &op, peer);
+}
+
+int stream_post_write(struct dccs_transport *transport, int peer, int handle, size_t offset, size_t length,
+        int remote_handle, size_t remote_offset, uint32_t imm, uint64_t id) {
+    struct dccs_stream_peer *p = stream_peer(transport, peer);
+    struct dccs_stream_op op = { .op = TRANSPORT_OP_WRITE, .handle = handle, .offset = offset, .length = length,
+        .remote_handle = remote_handle, .remote_offset = remote_offset, .imm = imm, .id = id };
+
+    return stream_enqueue(p->sends, p->send_head, &p->send_count, &op, peer);
+}
+
+/**
+ * Write as much of peer's queued frames as the stream takes. A send or a
+ * write completes once its whole frame is written.
+ */
+static int stream_push(struct dccs_transport *transport, int peer, struct dccs_completion *comps, int max, int *n) {
+    struct dccs_stream *stream = transport->state;
+    struct dccs_stream_peer *p = stream->peers + peer;
+    ssize_t moved;
+
+    while (p->send_count > 0 && *n < max) {
+        struct dccs_stream_op *op = p->sends + p->send_head;
+        struct dccs_frame *frame = &p->send_frame;
+        size_t total = sizeof(struct dccs_frame) + op->length;
+
+        if (p->send_done == 0) {
+            memset(frame, 0, sizeof(struct dccs_frame));
+            frame->op = htonl((uint32_t)op->op);
+            frame->imm = htonl(op->imm);
+            frame->handle = htonl((uint32_t)op->remote_handle);
+            frame->offset = htonll(op->remote_offset);
+            frame->length = htonll(op->length);
+        }
+        if (p->send_done < sizeof(struct dccs_frame)) {
+            if ((moved = stream->write(transport, peer, (uint8_t *)frame + p->send_done, sizeof(struct dccs_frame) - p->send_done)) < 0)
+                return -1;
+            p->send_done += (size_t)moved;
+        }
+        if (p->send_done >= sizeof(struct dccs_frame) && p->send_done < total) {
+            size_t done = p->send_done - sizeof(struct dccs_frame);
+            if ((moved = stream->write(transport, peer, transport->bufs[op->handle] + op->offset + done, op->length - done)) < 0)
+                return -1;
+            p->send_done += (size_t)moved;
+        }
+        if (p->send_done < total)
+            return 0;
+
+        memset(comps + *n, 0, sizeof(struct dccs_completion));
+        comps[*n].op = op->op;
+        comps[*n].peer = peer;
+        comps[*n].id = op->id;
+        (*n)++;
+        p->send_head = (p->send_head + 1) % TRANSPORT_QUEUE_DEPTH;
+        p->send_count--;
+        p->send_done = 0;
+    }
+
+    return 0;
+}
+
+/**
+ * Read as much of peer's incoming frames as there are receives posted for.
+ * Sends land where their receive says, writes where they say.
+ */
+static int stream_pull(struct dccs_transport *transport, int peer, struct dccs_completion *comps, int max, int *n) {
+    struct dccs_stream *stream = transport->state;
+    struct dccs_stream_peer *p = stream->peers + peer;
+    ssize_t moved;
+
+    while (p->recv_count > 0 && *n < max) {
+        struct dccs_stream_op *recv = p->recvs + p->recv_head;
+        struct dccs_frame *frame = &p->recv_frame;
+
+        if (p->recv_done < sizeof(struct dccs_frame)) {
+            if ((moved = stream->read(transport, peer, (uint8_t *)frame + p->recv_done, sizeof(struct dccs_frame) - p->recv_done)) < 0)
+                return -1;
+            p->recv_done += (size_t)moved;
+            if (p->recv_done < sizeof(struct dccs_frame))
+                return 0;
+        }
+
+        TransportOp op = (TransportOp)ntohl(frame->op);
+        size_t length = ntohll(frame->length);
+        uint8_t *dest;
+        if (op == TRANSPORT_OP_SEND) {
+            if (length > recv->length) {
+                log_error("A send of %zu B from rank %d overflows a receive of %zu B.\n", length, peer, recv->length);
+                return -1;
+            }
+            dest = transport->bufs[recv->handle] + recv->offset;
+        } else if (op == TRANSPORT_OP_WRITE) {
+            uint32_t handle = ntohl(frame->handle);
+            size_t offset = ntohll(frame->offset);
+            if (handle >= TRANSPORT_MAX_BUFFERS || transport->bufs[handle] == NULL
+                    || offset > transport->lengths[handle] || length > transport->lengths[handle] - offset) {
+                log_error("A write of %zu B from rank %d is out of buffer %u.\n", length, peer, handle);
+                return -1;
+            }
+            dest = transport->bufs[handle] + offset;
+        } else {
+            log_error("Unexpected frame %d from rank %d.\n", op, peer);
+            return -1;
+        }
+
+        size_t done = p->recv_done - sizeof(struct dccs_frame);
+        if (done < length) {
+            if ((moved = stream->read(transport, peer, dest + done, length - done)) < 0)
+                return -1;
+            p->recv_done += (size_t)moved;
+            if ((size_t)moved < length - done)
+                return 0;
+        }
+
+        memset(comps + *n, 0, sizeof(struct dccs_completion));
+        comps[*n].op = op == TRANSPORT_OP_SEND ? TRANSPORT_OP_RECV : TRANSPORT_OP_NOTIFY;
+        comps[*n].peer = peer;
+        comps[*n].id = recv->id;
+        comps[*n].length = length;
+        comps[*n].imm = ntohl(frame->imm);
+        (*n)++;
+        p->recv_head = (p->recv_head + 1) % TRANSPORT_QUEUE_DEPTH;
+        p->recv_count--;
+        p->recv_done = 0;
+    }
+
+    return 0;
+}
+
+/**
+ * Push and pull every peer's stream once, starting after the last peer
+ * polled so none is starved.
+ */
+int stream_poll(struct dccs_transport *transport, struct dccs_completion *comps, int max) {
+    struct dccs_stream *stream = transport->state;
+    int n = 0;
+
+    for (int i = 0; i < transport->size && n < max; i++) {
+        int peer = (stream->next_peer + i) % transport->size;
+        if (peer == transport->rank)
+            continue;
+
+        if (stream_push(transport, peer, comps, max, &n) != 0 || stream_pull(transport, peer, comps, max, &n) != 0)
+            return -1;
+    }
+    stream->next_peer = (stream->next_peer + 1) % transport->size;
+
+    return n;
+}
+
+/**
+ * Buffers are only ever touched by their own rank: a write names its
+ * target by handle.
+ */
+int stream_reg(struct dccs_transport *transport, int handle) {
+    (void)transport;
+    (void)handle;
+    return 0;
+}
+
+void stream_dereg(struct dccs_transport *transport, int handle) {
+    (void)transport;
+    (void)handle;
+}
+
+/* Shared memory */
+
+/**
+ * A single-producer, single-consumer byte ring from one rank to another.
+ * Head and tail only grow, each written by one side, on cache lines of
+ * their own.
+ */
+struct dccs_shm_ring {
+    _Atomic size_t head;    // Bytes written
+    uint8_t head_pad[CACHE_LINE_SIZE - sizeof(size_t)];
+    _Atomic size_t tail;    // Bytes read
+    uint8_t tail_pad[CACHE_LINE_SIZE - sizeof(size_t)];
+    uint8_t data[TRANSPORT_SHM_RING_BYTES];
+};
+
+struct dccs_shm_transport {
+    struct dccs_stream stream;
+    struct dccs_shm_ring *rings;    // From rank i to rank j at i * size + j
+    size_t bytes;
+};
+
+static inline struct dccs_shm_ring *shm_ring(struct dccs_transport *transport, int from, int to) {
+    struct dccs_shm_transport *shm = transport->state;
+    return shm->rings + (size_t)from * (size_t)transport->size + (size_t)to;
+}
+
+ssize_t shm_write(struct dccs_transport *transport, int peer, const void *buf, size_t length) {
+    struct dccs_shm_ring *ring = shm_ring(transport, transport->rank, peer);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t n = TRANSPORT_SHM_RING_BYTES - (head - tail), at = head % TRANSPORT_SHM_RING_BYTES;
+
+    n = n < length ? n : length;
+    size_t first = n < TRANSPORT_SHM_RING_BYTES - at ? n : TRANSPORT_SHM_RING_BYTES - at;
+    memcpy(ring->data + at, buf, first);
+    memcpy(ring->data, (const uint8_t *)buf + first, n - first);
+    atomic_store_explicit(&ring->head, head + n, memory_order_release);
+
+    return (ssize_t)n;
+}
+
+ssize_t shm_read(struct dccs_transport *transport, int peer, void *buf, size_t length) {
+    struct dccs_shm_ring *ring = shm_ring(transport, peer, transport->rank);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t n = head - tail, at = tail % TRANSPORT_SHM_RING_BYTES;
+
+    n = n < length ? n : length;
+    size_t first = n < TRANSPORT_SHM_RING_BYTES - at ? n : TRANSPORT_SHM_RING_BYTES - at;
+    memcpy(buf, ring->data + at, first);
+    memcpy((uint8_t *)buf + first, ring->data, n - first);
+    atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+
+    return (ssize_t)n;
+}
+
+/**
+ * Map one segment of size x size rings into every rank. Rank 0 creates it
+ * under a name of its pid, and unlinks it once every rank has it mapped.
+ */
+int shm_transport_init(struct dccs_transport *transport, struct dccs_parameters *params) {
+    struct dccs_shm_transport *shm = calloc(1, sizeof(struct dccs_shm_transport));
+    struct dccs_hosts hosts;
+    char name[NAME_MAX] = {0};
+    int fd = -1, ok = 1;
+
+    (void)params;
+    if ((transport->state = shm) == NULL || gather_hosts(&hosts, transport->size, DEFAULT_PORT) != 0)
+        return -1;
+    for (int r = 0; r < transport->size; r++)
+        ok &= strcmp(hosts.hosts[r], hosts.hosts[transport->rank]) == 0;
+    free_hosts(&hosts);
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    if (!ok) {
+        log_error("The shm transport needs every rank on one host.\n");
+        return -1;
+    }
+
+    shm->bytes = (size_t)transport->size * (size_t)transport->size * sizeof(struct dccs_shm_ring);
+    if (transport->rank == 0) {
+        snprintf(name, sizeof name, "/dccs-shm-%d", (int)getpid());
+        if ((fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR)) < 0) {
+            log_perror("shm_open");
+            name[0] = '\0';
+        } else if (ftruncate(fd, (off_t)shm->bytes) != 0) {
+            log_perror("ftruncate");
+            close(fd);
+            shm_unlink(name);
+            name[0] = '\0';
+        }
+    }
+    MPI_Bcast(name, sizeof name, MPI_CHAR, 0, MPI_COMM_WORLD);
+    if (name[0] == '\0')
+        return -1;
+
+    if (transport->rank != 0)
+        fd = shm_open(name, O_RDWR, 0);
+    if (fd >= 0) {
+        shm->rings = mmap(NULL, shm->bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    }
+    ok = fd >= 0 && shm->rings != MAP_FAILED;
+    if (!ok) {
+        log_perror("mmap");
+        shm->rings = NULL;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    if (transport->rank == 0)
+        shm_unlink(name);
+    if (!ok)
+        return -1;
+
+    return stream_init(transport, shm_write, shm_read);
+}
+
+void shm_transport_destroy(struct dccs_transport *transport) {
+    struct dccs_shm_transport *shm = transport->state;
+
+    if (shm == NULL)
+        return;
+    stream_destroy(transport);
+    if (shm->rings != NULL)
+        munmap(shm->rings, shm->bytes);
+    free(shm);
+}
+
+const struct dccs_transport_ops shm_transport_ops = {
+    .name = "shm",
+    .init = shm_transport_init,
+    .destroy = shm_transport_destroy,
+    .reg = stream_reg,
+    .dereg = stream_dereg,
+    .post_send = stream_post_send,
+    .post_recv = stream_post_recv,
+    .post_write = stream_post_write,
+    .poll = stream_poll,
+};
+
+/* TCP */
+
+struct dccs_tcp_transport {
+    struct dccs_stream stream;
+    int listen_fd;
+    int *fds;       // Per peer, -1 for ourselves
+};
+
+ssize_t tcp_write(struct dccs_transport *transport, int peer, const void *buf, size_t length) {
+    struct dccs_tcp_transport *tcp = transport->state;
+    ssize_t n = send(tcp->fds[peer], buf, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return 0;
+    if (n < 0)
+        log_perror("send");
+    return n;
+}
+
+ssize_t tcp_read(struct dccs_transport *transport, int peer, void *buf, size_t length) {
+    struct dccs_tcp_transport *tcp = transport->state;
+    ssize_t n = recv(tcp->fds[peer], buf, length, MSG_DONTWAIT);
+
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return 0;
+    if (n < 0)
+        log_perror("recv");
+    if (n == 0) {
+        log_error("Rank %d closed its connection.\n", peer);
+        return -1;
+    }
+    return n;
+}
+
+static int tcp_listen(char *port, int backlog) {
+    struct addrinfo hints, *res, *ai;
+    int fd = -1, one = 1;
+
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if (getaddrinfo(NULL, port, &hints, &res) != 0)
+        return -1;
+
+    for (ai = res; ai != NULL; ai = ai->ai_next) {
+        if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
+            continue;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, backlog) == 0)
+            break;
+        close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(res);
+    return fd;
+}
+
+static int tcp_connect(char *host, char *port) {
+    struct addrinfo hints, *res, *ai;
+    int fd = -1;
+
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res) != 0)
+        return -1;
+
+    for (ai = res; ai != NULL; ai = ai->ai_next) {
+        if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
+            continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+        close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(res);
+    return fd;
+}
+
+/**
+ * Connect to the ranks below ours and accept the ones above, as the verbs
+ * transport does. Connecting ranks name themselves in their first bytes.
+ */
+static int tcp_connect_mesh(struct dccs_transport *transport, struct dccs_hosts *hosts) {
+    struct dccs_tcp_transport *tcp = transport->state;
+    uint32_t rank;
+    int one = 1;
+
+    for (int peer = 0; peer < transport->rank; peer++) {
+        if ((tcp->fds[peer] = tcp_connect(hosts->hosts[peer], hosts->ports[peer])) < 0) {
+            log_error("Failed to connect to rank %d at %s:%s.\n", peer, hosts->hosts[peer], hosts->ports[peer]);
+            return -1;
+        }
+        rank = htonl((uint32_t)transport->rank);
+        if (send(tcp->fds[peer], &rank, sizeof rank, MSG_NOSIGNAL) != sizeof rank)
+            return -1;
+    }
+
+    for (int n = transport->rank + 1; n < transport->size; n++) {
+        int fd = accept(tcp->listen_fd, NULL, NULL);
+        if (fd < 0 || recv(fd, &rank, sizeof rank, MSG_WAITALL) != sizeof rank) {
+            log_perror("accept");
+            return -1;
+        }
+
+        int peer = (int)ntohl(rank);
+        if (peer <= transport->rank || peer >= transport->size || tcp->fds[peer] >= 0) {
+            log_error("Unexpected connection from rank %d.\n", peer);
+            close(fd);
+            return -1;
+        }
+        tcp->fds[peer] = fd;
+    }
+
+    for (int peer = 0; peer < transport->size; peer++) {
+        if (tcp->fds[peer] >= 0)
+            setsockopt(tcp->fds[peer], IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    }
+
+    return 0;
+}
+
+/**
+ * Each rank listens on params->port plus its rank, so ranks can share a
+ * host, loopback included.
+ */
+int tcp_transport_init(struct dccs_transport *transport, struct dccs_parameters *params) {
+    struct dccs_tcp_transport *tcp = calloc(1, sizeof(struct dccs_tcp_transport));
+    struct dccs_hosts hosts;
+    int listening, rv;
+
+    if ((transport->state = tcp) == NULL)
+        return -1;
+    tcp->listen_fd = -1;
+    if ((tcp->fds = malloc((size_t)transport->size * sizeof(int))) == NULL)
+        return -1;
+    for (int peer = 0; peer < transport->size; peer++)
+        tcp->fds[peer] = -1;
+    if (gather_hosts(&hosts, transport->size, params->port) != 0)
+        return -1;
+
+    tcp->listen_fd = tcp_listen(hosts.ports[transport->rank], transport->size);
+    listening = tcp->listen_fd >= 0;
+    if (!listening)
+        log_error("rank = %d, failed to listen on port %s.\n", transport->rank, hosts.ports[transport->rank]);
+    MPI_Allreduce(MPI_IN_PLACE, &listening, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    rv = listening ? tcp_connect_mesh(transport, &hosts) : -1;
+    free_hosts(&hosts);
+    if (rv != 0)
+        return -1;
+
+    return stream_init(transport, tcp_write, tcp_read);
+}
+
+void tcp_transport_destroy(struct dccs_transport *transport) {
+    struct dccs_tcp_transport *tcp = transport->state;
+
+    if (tcp == NULL)
+        return;
+    stream_destroy(transport);
+    for (int peer = 0; tcp->fds != NULL && peer < transport->size; peer++) {
+        if (tcp->fds[peer] >= 0)
+            close(tcp->fds[peer]);
+    }
+    if (tcp->listen_fd >= 0)
+        close(tcp->listen_fd);
+    free(tcp->fds);
+    free(tcp);
+}
+
+const struct dccs_transport_ops tcp_transport_ops = {
+    .name = "tcp",
+    .init = tcp_transport_init,
+    .destroy = tcp_transport_destroy,
+    .reg = stream_reg,
+    .dereg = stream_dereg,
+    .post_send = stream_post_send,
+    .post_recv = stream_post_recv,
+    .post_write = stream_post_write,
+    .poll = stream_poll,
+};
+
+#endif // DCCS_TRANSPORT_STREAM_H
@@ -0,0 +1,330 @@
+/**
+ * Verbs transport for DC circuit switch
+ */
+
+#ifndef DCCS_TRANSPORT_VERBS_H
+#define DCCS_TRANSPORT_VERBS_H
+
+#include <arpa/inet.h>
+
+#include "dccs_rdma.h"
+#include "dccs_transport.h"
+
+/**
+ * A connection to every other rank. All connections share the device's
+ * default PD, as in ring_init(), so one MR per buffer serves every peer.
+ */
+struct dccs_verbs_transport {
+    struct dccs_hosts hosts;
+    struct rdma_cm_id *listen_id;
+    struct rdma_cm_id **ids;                            // Per peer, NULL for ourselves
+    struct ibv_mr *mrs[TRANSPORT_MAX_BUFFERS];          // Per handle
+    struct dccs_mr_info *remote[TRANSPORT_MAX_BUFFERS]; // Per handle, every rank's buffer
+    int next_peer;                                      // Where polling resumes
+};
+
+/**
+ * Connect to the ranks below ours and accept the ones above, once every
+ * rank listens. A rank waits only on lower ones, which connect first and
+ * then accept, so there is no cycle. Connecting ranks name themselves in
+ * their first message.
+ */
+static int verbs_connect_mesh(struct dccs_transport *transport, uint32_t max_inline) {
+    struct dccs_verbs_transport *verbs = transport->state;
+    uint32_t rank;
+
+    for (int peer = 0; peer < transport->rank; peer++) {
+        if (dccs_connect(verbs->ids + peer, verbs->hosts.hosts[peer], verbs->hosts.ports[peer], max_inline) != 0) {
+            log_error("Failed to connect to rank %d at %s:%s.\n", peer, verbs->hosts.hosts[peer], verbs->hosts.ports[peer]);
+            return -1;
+        }
+        rank = htonl((uint32_t)transport->rank);
+        if (send_message(verbs->ids[peer], &rank, sizeof rank) < 0)
+            return -1;
+    }
+
+    for (int n = transport->rank + 1; n < transport->size; n++) {
+        struct rdma_cm_id *id;
+        if (dccs_accept(verbs->listen_id, &id, max_inline, NULL) != 0)
+            return -1;
+        if (recv_message(id, &rank, sizeof rank) < 0) {
+            dccs_client_disconnect(id);
+            return -1;
+        }
+
+        int peer = (int)ntohl(rank);
+        if (peer <= transport->rank || peer >= transport->size || verbs->ids[peer] != NULL) {
+            log_error("Unexpected connection from rank %d.\n", peer);
+            dccs_client_disconnect(id);
+            return -1;
+        }
+        verbs->ids[peer] = id;
+    }
+
+    return 0;
+}
+
+static inline struct rdma_cm_id *verbs_first_id(struct dccs_transport *transport) {
+    struct dccs_verbs_transport *verbs = transport->state;
+    return verbs->ids[transport->rank == 0 ? 1 : 0];
+}
+
+/**
+ * Each rank listens on params->port plus its rank, so ranks can share a
+ * host. Every other rank would wait on one that failed to set up, so
+ * callers abort on failure.
+ */
+int verbs_transport_init(struct dccs_transport *transport, struct dccs_parameters *params) {
+    struct dccs_verbs_transport *verbs = calloc(1, sizeof(struct dccs_verbs_transport));
+    int listening;
+
+    if ((transport->state = verbs) == NULL)
+        return -1;
+    if (transport->size < 2) {
+        log_error("The verbs transport needs at least 2 ranks.\n");
+        return -1;
+    }
+    if ((verbs->ids = calloc((size_t)transport->size, sizeof(struct rdma_cm_id *))) == NULL
+            || gather_hosts(&verbs->hosts, transport->size, params->port) != 0)
+        return -1;
+
+    listening = dccs_create_listener(&verbs->listen_id, verbs->hosts.ports[transport->rank], (uint32_t)params->max_inline, NULL) == 0;
+    if (!listening)
+        log_error("rank = %d, failed to listen on port %s.\n", transport->rank, verbs->hosts.ports[transport->rank]);
+    MPI_Allreduce(MPI_IN_PLACE, &listening, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    if (!listening || verbs_connect_mesh(transport, (uint32_t)params->max_inline) != 0)
+        return -1;
+
+    transport->inline_limit = dccs_inline_limit(verbs_first_id(transport));
+    return 0;
+}
+
+void verbs_transport_destroy(struct dccs_transport *transport) {
+    struct dccs_verbs_transport *verbs = transport->state;
+
+    if (verbs == NULL)
+        return;
+
+    mr_cache_flush();
+    for (int peer = 0; verbs->ids != NULL && peer < transport->size; peer++) {
+        if (verbs->ids[peer] != NULL)
+            dccs_client_disconnect(verbs->ids[peer]);
+    }
+    if (verbs->listen_id != NULL)
+        rdma_destroy_ep(verbs->listen_id);
+
+    free_hosts(&verbs->hosts);
+    free(verbs->ids);
+    free(verbs);
+}
+
+/**
+ * Register the buffer for every verb and trade its descriptor with every
+ * rank.
+ */
+int verbs_transport_reg(struct dccs_transport *transport, int handle) {
+    struct dccs_verbs_transport *verbs = transport->state;
+    struct dccs_mr_info local;
+    struct ibv_mr *mr;
+    int registered;
+
+    mr = dccs_reg_write(verbs_first_id(transport), transport->bufs[handle], transport->lengths[handle]);
+    registered = mr != NULL;
+    MPI_Allreduce(MPI_IN_PLACE, &registered, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    if (!registered) {
+        if (mr != NULL)
+            dccs_dereg_mr(mr);
+        return -1;
+    }
+
+    if ((verbs->remote[handle] = calloc((size_t)transport->size, sizeof(struct dccs_mr_info))) == NULL) {
+        dccs_dereg_mr(mr);
+        return -1;
+    }
+    memset(&local, 0, sizeof local);
+    local.addr = (uint64_t)(uintptr_t)transport->bufs[handle];
+    local.length = transport->lengths[handle];
+    local.rkey = mr->rkey;
+    MPI_Allgather(&local, sizeof local, MPI_BYTE, verbs->remote[handle], sizeof local, MPI_BYTE, MPI_COMM_WORLD);
+    verbs->mrs[handle] = mr;
+
+    return 0;
+}
+
+void verbs_transport_dereg(struct dccs_transport *transport, int handle) {
+    struct dccs_verbs_transport *verbs = transport->state;
+
+    dccs_dereg_mr(verbs->mrs[handle]);
+    free(verbs->remote[handle]);
+    verbs->mrs[handle] = NULL;
+    verbs->remote[handle] = NULL;
+}
+
+static inline void verbs_sge(struct dccs_transport *transport, int handle, size_t offset, size_t length, struct ibv_sge *sge) {
+    struct dccs_verbs_transport *verbs = transport->state;
+
+    sge->addr = (uint64_t)(uintptr_t)(transport->bufs[handle] + offset);
+    sge->length = (uint32_t)length;
+    sge->lkey = verbs->mrs[handle]->lkey;
+}
+
+int verbs_transport_post_send(struct dccs_transport *transport, int peer, int handle, size_t offset, size_t length, uint64_t id) {
+    struct dccs_verbs_transport *verbs = transport->state;
+    struct ibv_send_wr wr, *bad_wr;
+    struct ibv_sge sge;
+    int err;
+
+    verbs_sge(transport, handle, offset, length, &sge);
+    memset(&wr, 0, sizeof wr);
+    wr.wr_id = id;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.opcode = IBV_WR_SEND;
+    wr.send_flags = IBV_SEND_SIGNALED | (length <= transport->inline_limit ? IBV_SEND_INLINE : 0);
+    if ((err = ibv_post_send(verbs->ids[peer]->qp, &wr, &bad_wr)) != 0) {
+        log_error("Failed to post a send to rank %d: %s.\n", peer, strerror(err));
+        return -1;
+    }
+
+    return 0;
+}
+
+int verbs_transport_post_recv(struct dccs_transport *transport, int peer, int handle, size_t offset, size_t length, uint64_t id) {
+    struct dccs_verbs_transport *verbs = transport->state;
+    struct ibv_recv_wr wr, *bad_wr;
+    struct ibv_sge sge;
+    int err;
+
+    memset(&wr, 0, sizeof wr);
+    wr.wr_id = id;
+    if (length > 0) {
+        verbs_sge(transport, handle, offset, length, &sge);
+        wr.sg_list = &sge;
+        wr.num_sge = 1;
+    }
+    if ((err = ibv_post_recv(verbs->ids[peer]->qp, &wr, &bad_wr)) != 0) {
+        log_error("Failed to post a receive for rank %d, error = %d.\n", peer, err);
+        return -1;
+    }
+
+    return 0;
+}
+
+int verbs_transport_post_write(struct dccs_transport *transport, int peer, int handle, size_t offset, size_t length,
+        int remote_handle, size_t remote_offset, uint32_t imm, uint64_t id) {
+    struct dccs_verbs_transport *verbs = transport->state;
+    struct ibv_send_wr wr, *bad_wr;
+    struct ibv_sge sge;
+    int err;
+
+    if (remote_handle < 0 || remote_handle >= TRANSPORT_MAX_BUFFERS || verbs->remote[remote_handle] == NULL
+            || remote_offset + length > verbs->remote[remote_handle][peer].length) {
+        log_error("%zu B at offset %zu are out of buffer %d of rank %d.\n", length, remote_offset, remote_handle, peer);
+        return -1;
+    }
+
+    verbs_sge(transport, handle, offset, length, &sge);
+    memset(&wr, 0, sizeof wr);
+    wr.wr_id = id;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.opcode = IBV_WR_RDMA_WRITE_WITH_IMM;
+    wr.imm_data = htonl(imm);
+    wr.send_flags = IBV_SEND_SIGNALED | (length <= transport->inline_limit ? IBV_SEND_INLINE : 0);
+    wr.wr.rdma.remote_addr = verbs->remote[remote_handle][peer].addr + remote_offset;
+    wr.wr.rdma.rkey = verbs->remote[remote_handle][peer].rkey;
+    if ((err = ibv_post_send(verbs->ids[peer]->qp, &wr, &bad_wr)) != 0) {
+        log_error("Failed to post a write to rank %d: %s.\n", peer, strerror(err));
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Reap up to max completions of one CQ of peer's connection.
+ */
+static int verbs_poll_cq(struct ibv_cq *cq, int peer, struct dccs_completion *comps, int max) {
+    struct ibv_wc wcs[CQ_POLL_BATCH];
+    int polled;
+
+    if ((polled = ibv_poll_cq(cq, max < CQ_POLL_BATCH ? max : CQ_POLL_BATCH, wcs)) < 0) {
+        log_error("ibv_poll_cq() failed, error = %d.\n", polled);
+        return -1;
+    }
+
+    for (int i = 0; i < polled; i++) {
+        struct dccs_completion *comp = comps + i;
+        if (wcs[i].status != IBV_WC_SUCCESS) {
+            log_error("Failed status %s (%d) for WR ID %lu of rank %d.\n", ibv_wc_status_str(wcs[i].status), wcs[i].status, wcs[i].wr_id, peer);
+            return -1;
+        }
+
+        memset(comp, 0, sizeof(struct dccs_completion));
+        comp->peer = peer;
+        comp->id = wcs[i].wr_id;
+        switch (wcs[i].opcode) {
+            case IBV_WC_SEND:
+                comp->op = TRANSPORT_OP_SEND;
+                break;
+            case IBV_WC_RDMA_WRITE:
+                comp->op = TRANSPORT_OP_WRITE;
+                break;
+            case IBV_WC_RECV:
+                comp->op = TRANSPORT_OP_RECV;
+                comp->length = wcs[i].byte_len;
+                break;
+            case IBV_WC_RECV_RDMA_WITH_IMM:
+                comp->op = TRANSPORT_OP_NOTIFY;
+                comp->length = wcs[i].byte_len;
+                comp->imm = ntohl(wcs[i].imm_data);
+                break;
+            default:
+                log_error("Unexpected completion opcode %d from rank %d.\n", wcs[i].opcode, peer);
+                return -1;
+        }
+    }
+
+    return polled;
+}
+
+/**
+ * Poll every peer's CQs once, starting after the last peer polled so none
+ * is starved.
+ */
+int verbs_transport_poll(struct dccs_transport *transport, struct dccs_completion *comps, int max) {
+    struct dccs_verbs_transport *verbs = transport->state;
+    int n = 0, polled;
+
+    for (int i = 0; i < transport->size && n < max; i++) {
+        int peer = (verbs->next_peer + i) % transport->size;
+        if (peer == transport->rank)
+            continue;
+
+        if ((polled = verbs_poll_cq(verbs->ids[peer]->send_cq, peer, comps + n, max - n)) < 0)
+            return -1;
+        n += polled;
+        if (n == max)
+            break;
+        if ((polled = verbs_poll_cq(verbs->ids[peer]->recv_cq, peer, comps + n, max - n)) < 0)
+            return -1;
+        n += polled;
+    }
+    verbs->next_peer = (verbs->next_peer + 1) % transport->size;
+
+    return n;
+}
+
+const struct dccs_transport_ops verbs_transport_ops = {
+    .name = "verbs",
+    .init = verbs_transport_init,
+    .destroy = verbs_transport_destroy,
+    .reg = verbs_transport_reg,
+    .dereg = verbs_transport_dereg,
+    .post_send = verbs_transport_post_send,
+    .post_recv = verbs_transport_post_recv,
+    .post_write = verbs_transport_post_write,
+    .poll = verbs_transport_poll,
+};
+
+#endif // DCCS_TRANSPORT_VERBS_H
@@ -5,8 +5,9 @@
 #ifndef DCCS_UTIL_H
 #define DCCS_UTIL_H
 
+#include <endian.h>
 #include <getopt.h>
-#include <openssl/sha.h>
+#include <pthread.h>
 #include <sched.h>
 #include <stdarg.h>
 #include <stdbool.h>
@@ -16,7 +17,11 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
 
+#include "dccs_affinity.h"
 #include "dccs_config.h"
 #include "dccs_parameters.h"
 
@@ -217,22 +222,85 @@ void sort_latencies(double *latencies, size_t count) {
 
 /* Init functions */
 
-void set_cpu_affinity() {
-  cpu_set_t set;
-  CPU_ZERO(&set);
-  CPU_SET(CPU_TO_USE, &set);
-  if (sched_setaffinity(0, sizeof(set), &set) == -1) {
-    log_perror("sched_setaffinity failed");
+/**
+ * Pin this process under the --pin policy. local_rank is its index among the
+ * processes of the run on this host.
+ */
+void set_cpu_affinity(struct dccs_parameters *params, int rank, int local_rank) {
+  struct dccs_binding binding;
+  char description[256];
+
+  if (affinity_pin(params->pin, params->nic, local_rank, &binding) != 0) {
+    log_perror("Failed to pin CPU");
     exit(EXIT_FAILURE);
   }
+
+  affinity_describe(&binding, description, sizeof(description));
+  log_info("rank = %d, %s.\n", rank, description);
 }
 
 void print_usage(char *argv0) {
-    log_warning("Usage: %s [-b <block size>] [--mr <mr count>] [-r <repeat>] [-v read|write] [-p <port>] [-m latency|throughput] [-w <warmup count>] [-V {verbose}] [server]\n", argv0);
+    log_warning("Usage: %s [-b <block size>] [--length-range <min>:<max>[:<factor>]] [--mr <mr count>] [-r <repeat>] [-v read|write|send|write-imm|write-send] [-p <port>] [-m latency|throughput] [-w <warmup count>] [--depth <outstanding requests>] [--signal <interval>] [--post-batch <requests per doorbell>] [--threads <client threads>] [--qps <QPs per thread>] [--clients <clients served>] [--srq] [--inline <max inline bytes>] [--completion poll|event|adaptive[:<µsec>]] [--direction 1-N|N-1|N-N] [--window <in-flight ops>] [--timing local|epoch] [--schedule all|shift|xor|random] [--pacing completion|slot:<µsec>] [--seed <payload seed>] [--output <summary file>] [--format csv|json] [--pin compact|scatter|none|list:<cpus> (pins itself, so launch with mpirun -bind-to none)] [--nic <RDMA device>] [--transport mpi|verbs|shm|tcp] [--duty-cycle <up µsec>:<down µsec>] [--rotate] [-V {verbose}] [server]\n", argv0);
+}
+
+const char *direction_name(int direction) {
+    switch (direction) {
+        case DIR_OUT:
+            return "1-N";
+        case DIR_IN:
+            return "N-1";
+        case DIR_BOTH:
+            return "N-N";
+        default:
+            return "Unknown";
+    }
+}
+
+const char *schedule_name(Schedule schedule) {
+    switch (schedule) {
+        case SCHEDULE_ALL:
+            return "all";
+        case SCHEDULE_SHIFT:
+            return "shift";
+        case SCHEDULE_XOR:
+            return "xor";
+        case SCHEDULE_RANDOM:
+            return "random";
+        default:
+            return "unknown";
+    }
+}
+
+const char *transport_name(Transport transport) {
+    switch (transport) {
+        case TRANSPORT_MPI:
+            return "mpi";
+        case TRANSPORT_VERBS:
+            return "verbs";
+        case TRANSPORT_SHM:
+            return "shm";
+        case TRANSPORT_TCP:
+            return "tcp";
+        default:
+            return "unknown";
+    }
+}
+
+const char *completion_name(Completion completion) {
+    switch (completion) {
+        case COMPLETION_POLL:
+            return "poll";
+        case COMPLETION_EVENT:
+            return "event";
+        case COMPLETION_ADAPTIVE:
+            return "adaptive";
+        default:
+            return "unknown";
+    }
 }
 
 void print_parameters(struct dccs_parameters *params) {
-    char *verb, *mode, *direction;
+    char *verb, *mode, *timing;
     switch (params->verb) {
         case Read:
             verb = "Read";
@@ -240,6 +308,15 @@ void print_parameters(struct dccs_parameters *params) {
         case Write:
             verb = "Write";
             break;
+        case Send:
+            verb = "Send";
+            break;
+        case WriteImm:
+            verb = "Write with immediate";
+            break;
+        case WriteSend:
+            verb = "Write and send";
+            break;
         default:
             verb = "Unknown";
             break;
@@ -257,23 +334,42 @@ void print_parameters(struct dccs_parameters *params) {
             break;
     }
 
-    switch (params->direction) {
-        case DIR_OUT:
-            direction = "1-N";
-            break;
-        case DIR_IN:
-            direction = "N-1";
+    switch (params->timing) {
+        case TIMING_LOCAL:
+            timing = "Local";
             break;
-        case DIR_BOTH:
-            direction = "N-N";
+        case TIMING_EPOCH:
+            timing = "Epoch";
             break;
         default:
-            direction = "Unknown";
+            timing = "Unknown";
             break;
     }
 
     log_info("Config: verb = %s, count = %zu, length = %zu, server = %s, port = %s.\n", verb, params->count, params->length, params->server, params->port);
-    log_info("Config: mode = %s, warmup count = %zu, direction = %s, verbose = %d.\n", mode, params->warmup_count, direction, params->verbose);
+    if (params->length_min != params->length_max)
+        log_info("Config: length range = %zu to %zu, factor = %zu.\n", params->length_min, params->length_max, params->length_factor);
+    log_info("Config: payload seed = %lu.\n", params->seed);
+    log_info("Config: RDMA depth = %zu, signal interval = %zu, post batch = %zu, max inline = %zu.\n", params->depth, params->signal_interval, params->post_batch, params->max_inline);
+    if (params->threads * params->qps > 1)
+        log_info("Config: RDMA threads = %zu, QPs per thread = %zu.\n", params->threads, params->qps);
+    if (params->server == NULL)
+        log_info("Config: RDMA clients = %zu, SRQ = %s.\n", params->clients, params->srq ? "yes" : "no");
+    if (params->completion == COMPLETION_ADAPTIVE)
+        log_info("Config: completion = adaptive, poll budget = %zuµsec.\n", params->poll_budget_us);
+    else
+        log_info("Config: completion = %s.\n", completion_name(params->completion));
+    if (params->schedule != SCHEDULE_ALL) {
+        if (params->pacing == PACING_SLOT)
+            log_info("Config: schedule = %s, pacing = slot of %zuµsec.\n", schedule_name(params->schedule), params->slot_us);
+        else
+            log_info("Config: schedule = %s, pacing = completion.\n", schedule_name(params->schedule));
+    }
+    if (params->output != NULL)
+        log_info("Config: summary = %s, format = %s.\n", params->output, params->format == FORMAT_JSON ? "json" : "csv");
+    log_info("Config: pin = %s, nic = %s.\n", params->pin, params->nic == NULL ? "first" : params->nic);
+    log_info("Config: transport = %s.\n", transport_name(params->transport));
+    log_info("Config: mode = %s, warmup count = %zu, direction = %s, window = %zu, timing = %s, verbose = %d.\n", mode, params->warmup_count, direction_name(params->direction), params->window, timing, params->verbose);
 }
 
 /**
@@ -297,19 +393,67 @@ void parse_args(int argc, char *argv[], struct dccs_parameters *params) {
     params->verb = Read;
     params->count = DEFAULT_MESSAGE_COUNT;
     params->length = DEFAULT_MESSAGE_LENGTH;
+    params->length_factor = DEFAULT_LENGTH_FACTOR;
     params->server = NULL;
     params->port = DEFAULT_PORT;
     params->mode = MODE_LATENCY;
     params->warmup_count = DEFAULT_WARMUP_COUNT;
     params->mr_count = DEFAULT_MR_COUNT;
+    params->depth = DEFAULT_DEPTH;
+    params->signal_interval = DEFAULT_SIGNAL_INTERVAL;
+    params->post_batch = DEFAULT_POST_BATCH;
+    params->threads = DEFAULT_THREADS;
+    params->qps = DEFAULT_QPS;
+    params->clients = DEFAULT_CLIENTS;
+    params->srq = false;
+    params->max_inline = DEFAULT_MAX_INLINE;
+    params->inline_limit = 0;
+    params->completion = DEFAULT_COMPLETION;
+    params->poll_budget_us = DEFAULT_POLL_BUDGET;
     params->direction = DEFAULT_DIRECTION;
+    params->window = DEFAULT_WINDOW;
+    params->timing = DEFAULT_TIMING;
+    params->schedule = DEFAULT_SCHEDULE;
+    params->pacing = DEFAULT_PACING;
+    params->output = NULL;
+    params->format = DEFAULT_FORMAT;
+    params->seed = DEFAULT_SEED;
+    params->pin = DEFAULT_PIN;
+    params->nic = NULL;
+    params->transport = DEFAULT_TRANSPORT;
+    params->uptime_us = DCCS_CYCLE_UPTIME;
+    params->downtime_us = DCCS_CYCLE_DOWNTIME;
+    params->rotate = false;
     params->verbose = false;
 
     while (true) {
 #define OPT_MR_COUNT 1001
 #define OPT_DIRECTION 1002
+#define OPT_WINDOW 1003
+#define OPT_TIMING 1004
+#define OPT_LENGTH_RANGE 1005
+#define OPT_SEED 1006
+#define OPT_PIN 1007
+#define OPT_NIC 1008
+#define OPT_SCHEDULE 1009
+#define OPT_PACING 1010
+#define OPT_OUTPUT 1011
+#define OPT_FORMAT 1012
+#define OPT_DEPTH 1013
+#define OPT_SIGNAL 1014
+#define OPT_POST_BATCH 1015
+#define OPT_INLINE 1016
+#define OPT_COMPLETION 1017
+#define OPT_THREADS 1018
+#define OPT_QPS 1019
+#define OPT_CLIENTS 1020
+#define OPT_SRQ 1021
+#define OPT_TRANSPORT 1022
+#define OPT_DUTY_CYCLE 1023
+#define OPT_ROTATE 1024
         static struct option long_options[] = {
             { "block_size", required_argument, 0, 'b' },
+            { "length-range", required_argument, 0, OPT_LENGTH_RANGE },
             { "mr_count", required_argument, 0, OPT_MR_COUNT },
             { "repeat", required_argument, 0, 'r' },
             { "verb", required_argument, 0, 'v' },
@@ -317,6 +461,27 @@ void parse_args(int argc, char *argv[], struct dccs_parameters *params) {
             { "mode", required_argument, 0, 'm' },
             { "warmup", required_argument, 0, 'w' },
             { "direction", required_argument, 0, OPT_DIRECTION },
+            { "window", required_argument, 0, OPT_WINDOW },
+            { "timing", required_argument, 0, OPT_TIMING },
+            { "seed", required_argument, 0, OPT_SEED },
+            { "schedule", required_argument, 0, OPT_SCHEDULE },
+            { "pacing", required_argument, 0, OPT_PACING },
+            { "depth", required_argument, 0, OPT_DEPTH },
+            { "signal", required_argument, 0, OPT_SIGNAL },
+            { "post-batch", required_argument, 0, OPT_POST_BATCH },
+            { "inline", required_argument, 0, OPT_INLINE },
+            { "completion", required_argument, 0, OPT_COMPLETION },
+            { "threads", required_argument, 0, OPT_THREADS },
+            { "qps", required_argument, 0, OPT_QPS },
+            { "clients", required_argument, 0, OPT_CLIENTS },
+            { "srq", no_argument, 0, OPT_SRQ },
+            { "output", required_argument, 0, OPT_OUTPUT },
+            { "format", required_argument, 0, OPT_FORMAT },
+            { "pin", required_argument, 0, OPT_PIN },
+            { "nic", required_argument, 0, OPT_NIC },
+            { "transport", required_argument, 0, OPT_TRANSPORT },
+            { "duty-cycle", required_argument, 0, OPT_DUTY_CYCLE },
+            { "rotate", no_argument, 0, OPT_ROTATE },
             { "verbose", no_argument, 0, 'V' },
             { "help", no_argument, 0, 'h' }
         };
@@ -343,8 +508,14 @@ void parse_args(int argc, char *argv[], struct dccs_parameters *params) {
                     params->verb = Read;
                 } else if (strcmp(optarg, "write") == 0) {
                     params->verb = Write;
+                } else if (strcmp(optarg, "send") == 0) {
+                    params->verb = Send;
+                } else if (strcmp(optarg, "write-imm") == 0) {
+                    params->verb = WriteImm;
+                } else if (strcmp(optarg, "write-send") == 0) {
+                    params->verb = WriteSend;
                 } else {
-                    dccs_validate(false, argv, "verb must be 'read' or 'write'.\n");
+                    dccs_validate(false, argv, "verb must be 'read', 'write', 'send', 'write-imm' or 'write-send'.\n");
                 }
 
                 break;
@@ -366,6 +537,150 @@ void parse_args(int argc, char *argv[], struct dccs_parameters *params) {
                     goto invalid;
                 }
 
+                break;
+            case OPT_LENGTH_RANGE:
+                if (sscanf(optarg, "%zu:%zu:%zu", &(params->length_min), &(params->length_max), &(params->length_factor)) < 2) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_SEED:
+                if (sscanf(optarg, "%lu", &(params->seed)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_SCHEDULE:
+                if (strcmp(optarg, "all") == 0) {
+                    params->schedule = SCHEDULE_ALL;
+                } else if (strcmp(optarg, "shift") == 0) {
+                    params->schedule = SCHEDULE_SHIFT;
+                } else if (strcmp(optarg, "xor") == 0) {
+                    params->schedule = SCHEDULE_XOR;
+                } else if (strcmp(optarg, "random") == 0) {
+                    params->schedule = SCHEDULE_RANDOM;
+                } else {
+                    dccs_validate(false, argv, "schedule must be 'all', 'shift', 'xor' or 'random'.\n");
+                }
+
+                break;
+            case OPT_PACING:
+                if (strcmp(optarg, "completion") == 0) {
+                    params->pacing = PACING_COMPLETION;
+                } else if (sscanf(optarg, "slot:%zu", &(params->slot_us)) == 1) {
+                    params->pacing = PACING_SLOT;
+                } else {
+                    dccs_validate(false, argv, "pacing must be 'completion' or 'slot:<µsec>'.\n");
+                }
+
+                break;
+            case OPT_DEPTH:
+                if (sscanf(optarg, "%zu", &(params->depth)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_SIGNAL:
+                if (sscanf(optarg, "%zu", &(params->signal_interval)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_POST_BATCH:
+                if (sscanf(optarg, "%zu", &(params->post_batch)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_INLINE:
+                if (sscanf(optarg, "%zu", &(params->max_inline)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_THREADS:
+                if (sscanf(optarg, "%zu", &(params->threads)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_QPS:
+                if (sscanf(optarg, "%zu", &(params->qps)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_CLIENTS:
+                if (sscanf(optarg, "%zu", &(params->clients)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_SRQ:
+                params->srq = true;
+                break;
+            case OPT_COMPLETION:
+                if (strcmp(optarg, "poll") == 0) {
+                    params->completion = COMPLETION_POLL;
+                } else if (strcmp(optarg, "event") == 0) {
+                    params->completion = COMPLETION_EVENT;
+                } else if (strcmp(optarg, "adaptive") == 0) {
+                    params->completion = COMPLETION_ADAPTIVE;
+                } else if (sscanf(optarg, "adaptive:%zu", &(params->poll_budget_us)) == 1) {
+                    params->completion = COMPLETION_ADAPTIVE;
+                } else {
+                    dccs_validate(false, argv, "completion must be 'poll', 'event' or 'adaptive[:<µsec>]'.\n");
+                }
+
+                break;
+            case OPT_OUTPUT:
+                params->output = optarg;
+                break;
+            case OPT_FORMAT:
+                if (strcmp(optarg, "csv") == 0) {
+                    params->format = FORMAT_CSV;
+                } else if (strcmp(optarg, "json") == 0) {
+                    params->format = FORMAT_JSON;
+                } else {
+                    dccs_validate(false, argv, "format must be 'csv' or 'json'.\n");
+                }
+
+                break;
+            case OPT_PIN: {
+                PinPolicy policy;
+                const char *list;
+                if (affinity_parse_policy(optarg, &policy, &list) != 0) {
+                    dccs_validate(false, argv, "pin must be 'compact', 'scatter', 'none' or 'list:<cpus>'.\n");
+                }
+                params->pin = optarg;
+
+                break;
+            }
+            case OPT_NIC:
+                params->nic = optarg;
+                break;
+            case OPT_TRANSPORT:
+                if (strcmp(optarg, "mpi") == 0) {
+                    params->transport = TRANSPORT_MPI;
+                } else if (strcmp(optarg, "verbs") == 0) {
+                    params->transport = TRANSPORT_VERBS;
+                } else if (strcmp(optarg, "shm") == 0) {
+                    params->transport = TRANSPORT_SHM;
+                } else if (strcmp(optarg, "tcp") == 0) {
+                    params->transport = TRANSPORT_TCP;
+                } else {
+                    dccs_validate(false, argv, "transport must be 'mpi', 'verbs', 'shm' or 'tcp'.\n");
+                }
+
+                break;
+            case OPT_DUTY_CYCLE:
+                if (sscanf(optarg, "%zu:%zu", &(params->uptime_us), &(params->downtime_us)) != 2) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_ROTATE:
+                params->rotate = true;
                 break;
             case OPT_MR_COUNT:
                 if (sscanf(optarg, "%zu", &(params->mr_count)) != 1) {
@@ -384,6 +699,22 @@ void parse_args(int argc, char *argv[], struct dccs_parameters *params) {
                     goto invalid;
                 }
 
+                break;
+            case OPT_WINDOW:
+                if (sscanf(optarg, "%zu", &(params->window)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_TIMING:
+                if (strcmp(optarg, "local") == 0) {
+                    params->timing = TIMING_LOCAL;
+                } else if (strcmp(optarg, "epoch") == 0) {
+                    params->timing = TIMING_EPOCH;
+                } else {
+                    dccs_validate(false, argv, "timing must be 'local' or 'epoch'.\n");
+                }
+
                 break;
             case 'V':
                 params->verbose = true;
@@ -405,10 +736,30 @@ void parse_args(int argc, char *argv[], struct dccs_parameters *params) {
         params->server = argv[optind];
     }
 
+    if (params->length_min == 0 && params->length_max == 0)
+        params->length_min = params->length_max = params->length;
+    params->length = params->length_max;
+
     // Validation of arguments
     dccs_validate(params->count > 0, argv, "count must be a positive integer.\n");
     dccs_validate(params->length > 0, argv, "length must be a positive integer.\n");
+    dccs_validate(params->length_min > 0 && params->length_min <= params->length_max, argv, "length range must satisfy 0 < min <= max.\n");
+    dccs_validate(params->length_factor > 1, argv, "length range factor must be at least 2.\n");
     dccs_validate(params->mr_count > 0, argv, "mr count must be a positive integer.\n");
+    dccs_validate(params->window > 0, argv, "window must be a positive integer.\n");
+    dccs_validate(params->depth > 0 && params->depth <= MAX_WR, argv, "depth must be between 1 and the QP capacity of %d.\n", MAX_WR);
+    dccs_validate(params->verb != WriteSend || params->mode == MODE_LATENCY || params->depth <= MAX_WR / 2, argv, "write-send posts two WRs per request, depth must be at most %d.\n", MAX_WR / 2);
+    dccs_validate(params->signal_interval > 0 && params->signal_interval <= params->depth, argv, "signal interval must be between 1 and depth.\n");
+    dccs_validate(params->post_batch > 0, argv, "post batch must be a positive integer.\n");
+    dccs_validate(params->max_inline <= UINT32_MAX, argv, "max inline is too large.\n");
+    dccs_validate(params->threads > 0 && params->qps > 0, argv, "threads and QPs must be positive integers.\n");
+    dccs_validate(params->clients > 0, argv, "clients must be a positive integer.\n");
+    dccs_validate(params->clients == 1 || params->threads * params->qps == 1, argv, "several clients must use one connection each.\n");
+    dccs_validate(params->count % (params->threads * params->qps * params->mr_count) == 0, argv, "count must be a multiple of threads x QPs x MR count.\n");
+    dccs_validate((params->verb != WriteImm && params->verb != WriteSend) || params->count <= UINT32_MAX, argv, "count must fit a 32-bit sequence number.\n");
+    dccs_validate(params->schedule == SCHEDULE_ALL || params->direction == DIR_BOTH, argv, "schedule requires direction N-N.\n");
+    dccs_validate(params->pacing != PACING_SLOT || params->slot_us > 0, argv, "slot must be a positive number of µsec.\n");
+    dccs_validate(params->uptime_us > 0, argv, "duty cycle up time must be a positive number of µsec.\n");
     dccs_validate(params->count % params->mr_count == 0, argv, "count must be a multiple of MR count.\n");
 
     return;
@@ -419,16 +770,190 @@ invalid:
     exit(EXIT_FAILURE);
 }
 
-void dccs_init() {
+/**
+ * Next length of the --length-range sweep after the given one, or 0 at the end.
+ */
+size_t next_length(struct dccs_parameters *params, size_t length) {
+    if (length > params->length_max / params->length_factor)
+        return 0;
+
+    return length * params->length_factor;
+}
+
+void dccs_init(struct dccs_parameters *params, int rank, int local_rank) {
     clock_rate = get_clock_rate();
     log_debug("Clock rate = %lu.\n", clock_rate);
-    set_cpu_affinity();
+    set_cpu_affinity(params, rank, local_rank);
+}
+
+/* Helper threads */
+
+typedef void (*range_fn)(void *arg, size_t begin, size_t end);
+
+struct range_task {
+    range_fn fn;
+    void *arg;
+    size_t begin;
+    size_t end;
+};
+
+void *range_worker(void *arg) {
+    struct range_task *task = arg;
+    task->fn(task->arg, task->begin, task->end);
+    return NULL;
 }
 
 /**
- * Call malloc() and fill the memory with random data.
+ * Call fn on contiguous parts of [0, count), one per helper thread, and
+ * wait for all of them. Parts are multiples of align and at least
+ * min_per_thread long, so small ranges run inline on the caller. Helpers
+ * may run on any CPU, not just the one the caller is pinned to.
  */
-void *malloc_random(size_t size) {
+void parallel_ranges(size_t count, size_t min_per_thread, size_t align, range_fn fn, void *arg) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t thread_count = count / (min_per_thread > 0 ? min_per_thread : 1);
+    if (thread_count > HELPER_THREADS)
+        thread_count = HELPER_THREADS;
+    if (cpus > 0 && thread_count > (size_t)cpus)
+        thread_count = (size_t)cpus;
+
+    if (thread_count <= 1) {
+        fn(arg, 0, count);
+        return;
+    }
+
+    pthread_t threads[HELPER_THREADS];
+    struct range_task tasks[HELPER_THREADS];
+    bool started[HELPER_THREADS] = { false };
+    pthread_attr_t attr;
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    for (size_t cpu = 0; cpu < (size_t)cpus && cpu < CPU_SETSIZE; cpu++)
+        CPU_SET(cpu, &set);
+    pthread_attr_init(&attr);
+    pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+
+    // The last thread takes the remainder
+    size_t share = (count / thread_count + align - 1) / align * align;
+    for (size_t t = 0; t < thread_count; t++) {
+        size_t begin = t * share;
+        if (begin >= count)
+            break;
+
+        tasks[t].fn = fn;
+        tasks[t].arg = arg;
+        tasks[t].begin = begin;
+        tasks[t].end = t == thread_count - 1 || begin + share > count ? count : begin + share;
+        if (pthread_create(threads + t, &attr, range_worker, tasks + t) != 0) {
+            log_warning("Failed to start helper thread %zu, running in place ...\n", t);
+            range_worker(tasks + t);
+            continue;
+        }
+        started[t] = true;
+    }
+
+    for (size_t t = 0; t < thread_count; t++) {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+/* Payload generation */
+
+/**
+ * Payload bytes come from a counter-based generator: 64-bit word i of
+ * stream (seed, stream) is a hash of the stream key and i, so any byte
+ * range can be generated, or regenerated for verification, independently.
+ */
+static inline uint64_t payload_word(uint64_t key, uint64_t index) {
+    // splitmix64 finalizer over a Weyl sequence
+    uint64_t z = key + index * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t payload_key(uint64_t seed, uint64_t stream) {
+    return payload_word(payload_word(seed, 0), stream);
+}
+
+static inline uint8_t payload_byte(uint64_t key, size_t offset) {
+    return (uint8_t)(payload_word(key, offset / 8) >> (8 * (offset % 8)));
+}
+
+/**
+ * Fill buf with length bytes of the stream starting at byte offset.
+ */
+void fill_payload_range(void *buf, size_t length, uint64_t key, size_t offset) {
+    uint8_t *p = buf;
+    size_t n = 0;
+
+    for (; n < length && (offset + n) % 8 != 0; n++)
+        p[n] = payload_byte(key, offset + n);
+
+    for (uint64_t w = (offset + n) / 8; n + 8 <= length; n += 8, w++) {
+        uint64_t v = htole64(payload_word(key, w));
+        memcpy(p + n, &v, 8);
+    }
+
+    for (; n < length; n++)
+        p[n] = payload_byte(key, offset + n);
+}
+
+struct payload_fill {
+    uint8_t *buf;
+    uint64_t key;
+    size_t offset;
+};
+
+void fill_payload_part(void *arg, size_t begin, size_t end) {
+    struct payload_fill *fill = arg;
+    fill_payload_range(fill->buf + begin, end - begin, fill->key, fill->offset + begin);
+}
+
+/**
+ * Fill buf with length bytes of stream (seed, stream) starting at byte
+ * offset, on helper threads for large buffers.
+ */
+void fill_payload(void *buf, size_t length, uint64_t seed, uint64_t stream, size_t offset) {
+    struct payload_fill fill = { buf, payload_key(seed, stream), offset };
+    parallel_ranges(length, HELPER_THREAD_BYTES, CACHE_LINE_SIZE, fill_payload_part, &fill);
+}
+
+/**
+ * Check buf against stream (seed, stream) starting at byte offset. Returns
+ * the index of the first mismatching byte, or length if all bytes match.
+ */
+size_t verify_payload(const void *buf, size_t length, uint64_t seed, uint64_t stream, size_t offset) {
+    uint64_t key = payload_key(seed, stream);
+    const uint8_t *p = buf;
+    size_t n = 0;
+
+    for (; n < length && (offset + n) % 8 != 0; n++) {
+        if (p[n] != payload_byte(key, offset + n))
+            return n;
+    }
+
+    for (uint64_t w = (offset + n) / 8; n + 8 <= length; n += 8, w++) {
+        uint64_t v = htole64(payload_word(key, w));
+        if (memcmp(p + n, &v, 8) != 0)
+            break;
+    }
+
+    for (; n < length; n++) {
+        if (p[n] != payload_byte(key, offset + n))
+            return n;
+    }
+
+    return length;
+}
+
+/**
+ * Allocate memory and fill it with stream (seed, stream) from byte offset.
+ */
+void *malloc_payload(size_t size, uint64_t seed, uint64_t stream, size_t offset) {
     void *buf;
 
     if (posix_memalign(&buf, CACHE_LINE_SIZE, size) != 0) {
@@ -440,35 +965,103 @@ void *malloc_random(size_t size) {
     if (buf == NULL)
         return buf;
 
-    srand((unsigned int)time(NULL));
-    for (size_t n = 0; n < size; n++) {
-        *((char *)buf + n) = (char)rand();
-    }
+    fill_payload(buf, size, seed, stream, offset);
 
     return buf;
 }
 
-/* OpenSSL hashing functions */
+/* CRC32C checksums */
+
+static uint32_t crc32c_table[256];
+static bool crc32c_hardware;
 
 /**
- * Calculate the SHA1 digest of the given data.
+ * Set up CRC32C: build the table for the portable version, and use the
+ * SSE4.2 crc32 instruction instead when the CPU has it.
  */
-void sha1sum(const void *data, size_t length, unsigned char digest[SHA_DIGEST_LENGTH]) {
-    SHA1(data, length, digest);
+void crc32c_init() {
+    if (crc32c_table[1] == 0) {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t crc = n;
+            for (int k = 0; k < 8; k++)
+                crc = crc & 1 ? (crc >> 1) ^ 0x82f63b78 : crc >> 1;
+            crc32c_table[n] = crc;
+        }
+    }
+
+#if defined(__x86_64__)
+    crc32c_hardware = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+uint32_t crc32c_sse42(uint32_t crc, const uint8_t *p, size_t length) {
+    uint64_t crc64 = crc;
+    size_t n = 0;
+
+    for (; n + 8 <= length; n += 8) {
+        uint64_t v;
+        memcpy(&v, p + n, 8);
+        crc64 = _mm_crc32_u64(crc64, v);
+    }
+
+    crc = (uint32_t)crc64;
+    for (; n < length; n++)
+        crc = _mm_crc32_u8(crc, p[n]);
+
+    return crc;
 }
+#endif
 
 /**
- * Calculate the SHA1 digest of the given array of data.
+ * CRC32C (Castagnoli) of the given data, continuing from crc (0 to start).
+ * Call crc32c_init() first.
  */
-void sha1sum_array(const void *array[], size_t count, size_t length, unsigned char digest[SHA_DIGEST_LENGTH]) {
-    SHA_CTX ctx;
-    SHA1_Init(&ctx);
-    for (size_t n = 0; n < count; n++) {
-        const void *data = array[n];
-        SHA1_Update(&ctx, data, length);
+uint32_t crc32c(uint32_t crc, const void *data, size_t length) {
+    const uint8_t *p = data;
+
+    crc = ~crc;
+#if defined(__x86_64__)
+    if (crc32c_hardware)
+        return ~crc32c_sse42(crc, p, length);
+#endif
+    for (size_t n = 0; n < length; n++)
+        crc = crc32c_table[(crc ^ p[n]) & 0xff] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+struct checksum_job {
+    const uint8_t *buf;
+    size_t length;
+    size_t chunk;
+    uint32_t *crcs;
+};
+
+void checksum_part(void *arg, size_t begin, size_t end) {
+    struct checksum_job *job = arg;
+    for (size_t c = begin; c < end; c++) {
+        size_t offset = c * job->chunk;
+        size_t length = offset + job->chunk > job->length ? job->length - offset : job->chunk;
+        job->crcs[c] = crc32c(0, job->buf + offset, length);
     }
+}
+
+static inline size_t checksum_chunk_count(size_t length, size_t chunk) {
+    return (length + chunk - 1) / chunk;
+}
+
+/**
+ * CRC32C of each chunk of buf (the last one may be short) into crcs, on
+ * helper threads for large buffers.
+ */
+void checksum_chunks(const void *buf, size_t length, size_t chunk, uint32_t *crcs) {
+    struct checksum_job job = { buf, length, chunk, crcs };
+    size_t chunks_per_thread = HELPER_THREAD_BYTES / chunk;
 
-    SHA1_Final(digest, &ctx);
+    crc32c_init();
+    parallel_ranges(checksum_chunk_count(length, chunk), chunks_per_thread, 1, checksum_part, &job);
 }
 
 #endif // DCCS_UTIL_H
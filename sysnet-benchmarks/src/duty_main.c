@@ -0,0 +1,190 @@
+// Duty-cycled sender tool
+//
+// Every rank writes to a peer over the --transport for the up time of each
+// circuit duty cycle, --duty-cycle <up>:<down> µsec, DCCS_CYCLE_UPTIME and
+// DCCS_CYCLE_DOWNTIME by default, and to the next peer every cycle with
+// --rotate. Each length is run twice: with the circuit always up, and then
+// duty-cycled, so their ratio is the efficiency the duty cycle leaves us.
+// MPI sets up the transport, syncs the clocks to a common start and gathers
+// the results.
+
+#define _GNU_SOURCE
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dccs_mpi.h"
+#include "dccs_utils.h"
+#include "dccs_transport.h"
+#include "dccs_duty.h"
+
+uint64_t clock_rate = 0;    // Clock ticks per second
+struct dccs_cq_wait cq_wait;    // How completions are waited for
+struct dccs_mr_cache mr_cache;  // Control message registrations
+
+/**
+ * Per length, what rank 0 prints at the end of a --length-range sweep.
+ */
+struct duty_summary {
+    size_t length;
+    double bytes_per_cycle;
+    double stranded;        // Fraction of the writes posted
+    double efficiency;
+};
+
+/**
+ * Sum every rank's measured cycles at rank 0, into totals there.
+ */
+void gather_cycles(struct dccs_duty *duty, size_t warmup, struct dccs_duty_cycle *totals) {
+    size_t cycles = duty->cycle_count - warmup;
+    int n = (int)(cycles * sizeof(struct dccs_duty_cycle) / sizeof(uint64_t));
+
+    MPI_Reduce(duty->cycles + warmup, totals, n, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+}
+
+/**
+ * Report the duty-cycled run against the always-up one at rank 0: bytes
+ * delivered per cycle across all ranks, the writes stranded by a
+ * reconfiguration and the bytes delivered relative to the always-up run.
+ */
+int report_run(struct dccs_duty *duty, struct dccs_parameters *params, size_t warmup, uint64_t baseline_bytes,
+        struct dccs_duty_cycle *totals, struct duty_summary *summary) {
+    size_t cycles = duty->cycle_count - warmup;
+    uint64_t posted = 0, stranded = 0, bytes = 0;
+    double *per_cycle = malloc(cycles * sizeof(double)), mean = 0;
+
+    if (per_cycle == NULL) {
+        log_error("Failed to allocate the report of %zu cycles.\n", cycles);
+        return -1;
+    }
+
+    for (size_t c = 0; c < cycles; c++) {
+        posted += totals[c].posted;
+        stranded += totals[c].stranded;
+        bytes += totals[c].bytes;
+        per_cycle[c] = (double)totals[c].bytes;
+        mean += per_cycle[c] / (double)cycles;
+    }
+
+    if (params->verbose) {
+        printf("Bytes delivered per cycle:\n");
+        for (size_t c = 0; c < cycles; c++)
+            printf("%.0f ", per_cycle[c]);
+        printf("\n\n");
+    }
+
+    qsort(per_cycle, cycles, sizeof(double), compare_double);
+    double ideal = (double)params->uptime_us / (double)(params->uptime_us + params->downtime_us);
+    summary->length = params->length;
+    summary->bytes_per_cycle = mean;
+    summary->stranded = posted > 0 ? (double)stranded / (double)posted : 0;
+    summary->efficiency = baseline_bytes > 0 ? (double)bytes / (double)baseline_bytes : 0;
+
+    log_info("length = %zu, cycles = %zu, bytes per cycle min = %.0f, median = %.0f, mean = %.0f, max = %.0f.\n",
+            params->length, cycles, per_cycle[0], per_cycle[cycles / 2], mean, per_cycle[cycles - 1]);
+    log_info("length = %zu, stranded = %lu of %lu writes (%.2f%%), efficiency = %.3f, ideal = %.3f.\n",
+            params->length, stranded, posted, summary->stranded * 100, summary->efficiency, ideal);
+
+    free(per_cycle);
+    return 0;
+}
+
+void print_summaries(struct duty_summary *summaries, size_t count) {
+    log_info("=====================\n");
+    log_info("Duty Cycle Report\n");
+    log_info("#bytes, bytes per cycle, stranded, efficiency\n");
+    for (size_t i = 0; i < count; i++)
+        log_info("%zu, %.0f, %.4f, %.4f\n", summaries[i].length, summaries[i].bytes_per_cycle, summaries[i].stranded, summaries[i].efficiency);
+    log_info("=====================\n\n");
+}
+
+/**
+ * The sender, and at rank 0 the results of each cycle and of each length.
+ */
+struct duty_state {
+    struct dccs_duty duty;
+    struct dccs_duty_cycle *totals;
+    struct duty_summary *summaries;
+    size_t lengths;
+    size_t l;               // Of the length being run
+    int64_t clock_offset;
+};
+
+int duty_tool_init(struct dccs_transport *transport, struct dccs_parameters *params, void *state) {
+    struct duty_state *ds = state;
+
+    memset(ds, 0, sizeof(struct duty_state));
+    if (duty_init(&ds->duty, transport, params) != 0)
+        return -1;
+    if (transport->rank == 0) {
+        log_info("Duty cycle = %zuµsec up, %zuµsec down, peers %s.\n",
+                params->uptime_us, params->downtime_us, params->rotate ? "rotating every cycle" : "fixed");
+        ds->totals = malloc(params->count * sizeof(struct dccs_duty_cycle));
+        for (size_t length = params->length_min; length != 0; length = next_length(params, length))
+            ds->lengths++;
+        ds->summaries = calloc(ds->lengths, sizeof(struct duty_summary));
+        if (ds->totals == NULL || ds->summaries == NULL) {
+            log_error("Failed to allocate the results of %zu cycles and %zu lengths.\n", params->count, ds->lengths);
+            return -1;
+        }
+    }
+    ds->clock_offset = sync_clock_offset(transport->size, transport->rank);
+    return 0;
+}
+
+int duty_tool_run(struct dccs_transport *transport, struct dccs_parameters *params, void *state) {
+    struct duty_state *ds = state;
+    size_t warmup = params->warmup_count, cycles = warmup + params->count;
+    uint64_t baseline_bytes = 0;
+    int rank = transport->rank, rv = 0;
+
+    // The same time with the circuit always up, then duty-cycled
+    for (int duty_cycled = 0; duty_cycled <= 1; duty_cycled++) {
+        size_t uptime_us = duty_cycled ? params->uptime_us : params->uptime_us + params->downtime_us;
+        size_t downtime_us = duty_cycled ? params->downtime_us : 0;
+
+        uint64_t epoch = wait_for_epoch(rank, ds->clock_offset);
+        if (duty_run(&ds->duty, params, (uint64_t)((int64_t)epoch - ds->clock_offset), cycles, uptime_us, downtime_us) != 0)
+            return -1;
+
+        gather_cycles(&ds->duty, warmup, ds->totals);
+        if (rank == 0 && !duty_cycled) {
+            for (size_t c = 0; c < params->count; c++)
+                baseline_bytes += ds->totals[c].bytes;
+        }
+        if (rank == 0 && duty_cycled && report_run(&ds->duty, params, warmup, baseline_bytes, ds->totals, ds->summaries + ds->l) != 0)
+            rv = 1;
+        if (duty_verify(&ds->duty, params) != 0)
+            rv = 1;
+    }
+
+    ds->l++;
+    return rv;
+}
+
+void duty_tool_finish(struct dccs_transport *transport, struct dccs_parameters *params, void *state) {
+    struct duty_state *ds = state;
+
+    (void)params;
+    if (transport->rank == 0)
+        print_summaries(ds->summaries, ds->lengths);
+
+    duty_destroy(&ds->duty);
+    free(ds->totals);
+    free(ds->summaries);
+}
+
+const struct dccs_transport_tool duty_tool = {
+    .name = "duty-cycled sender",
+    .check = NULL,
+    .init = duty_tool_init,
+    .run = duty_tool_run,
+    .finish = duty_tool_finish,
+};
+
+int main(int argc, char *argv[]) {
+    struct duty_state state;
+
+    return transport_tool_main(argc, argv, &duty_tool, &state);
+}
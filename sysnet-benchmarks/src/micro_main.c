@@ -0,0 +1,269 @@
+// Transport microbenchmark tool
+//
+// Ping-pong latency (-m latency) and streaming throughput (-m throughput)
+// from rank 0 to rank 1 over any --transport, with sends (-v send) or
+// notified writes (-v write or write-imm). Other ranks only take part in
+// setting it up. shm and tcp need no RDMA device, so any box can run it.
+
+#define _GNU_SOURCE
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dccs_mpi.h"
+#include "dccs_utils.h"
+#include "dccs_transport.h"
+
+uint64_t clock_rate = 0;    // Clock ticks per second
+struct dccs_cq_wait cq_wait;    // How completions are waited for
+struct dccs_mr_cache mr_cache;  // Control message registrations
+
+/**
+ * The two ends of the benchmark, with a payload buffer to send and one to
+ * receive into.
+ */
+struct micro {
+    struct dccs_transport *transport;
+    struct dccs_parameters *params;
+    int peer;
+    bool write;             // Notified writes rather than sends
+    int send_handle;
+    int recv_handle;
+    uint8_t *send_buf;
+    uint8_t *recv_buf;
+    size_t sent;            // Sends and writes completed
+    size_t received;        // Receives and notifications completed
+    double *rtts;           // Of a latency run
+    double seconds;         // Of a throughput run
+};
+
+/**
+ * Poll until sent of our sends and received of peer's have completed.
+ */
+int micro_wait(struct micro *micro, size_t sent, size_t received) {
+    struct dccs_completion comps[CQ_POLL_BATCH];
+
+    while (micro->sent < sent || micro->received < received) {
+        int polled = transport_poll(micro->transport, comps, CQ_POLL_BATCH);
+        if (polled < 0)
+            return -1;
+
+        for (int i = 0; i < polled; i++) {
+            if (comps[i].op == TRANSPORT_OP_SEND || comps[i].op == TRANSPORT_OP_WRITE)
+                micro->sent++;
+            else
+                micro->received++;
+        }
+    }
+
+    return 0;
+}
+
+static inline int micro_post(struct micro *micro, size_t length, uint64_t id) {
+    if (micro->write)
+        return transport_post_write(micro->transport, micro->peer, micro->send_handle, 0, length, micro->recv_handle, 0, (uint32_t)id, id);
+
+    return transport_post_send(micro->transport, micro->peer, micro->send_handle, 0, length, id);
+}
+
+static inline int micro_post_recv(struct micro *micro, uint64_t id) {
+    return transport_post_recv(micro->transport, micro->peer, micro->recv_handle, 0, micro->params->length, id);
+}
+
+/**
+ * Wait for the peer to have its first receives posted too: verbs would
+ * otherwise retry what arrives before them.
+ */
+static inline void micro_ready(struct micro *micro) {
+    int ready = 1, peer_ready;
+    MPI_Sendrecv(&ready, 1, MPI_INT, micro->peer, 0, &peer_ready, 1, MPI_INT, micro->peer, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+}
+
+/**
+ * Ping-pong length bytes warmup + count times, the next receive always
+ * posted before what it answers goes out. Rank 0 times the round trips.
+ */
+int run_latency(struct micro *micro, double *rtts) {
+    struct dccs_parameters *params = micro->params;
+    size_t rounds = params->warmup_count + params->count;
+    int rank = micro->transport->rank;
+
+    micro->sent = micro->received = 0;
+    if (micro_post_recv(micro, 0) != 0)
+        return -1;
+    micro_ready(micro);
+
+    for (size_t i = 0; i < rounds; i++) {
+        if (rank == 0) {
+            uint64_t start = get_cycles();
+            if (micro_post(micro, params->length, i) != 0 || micro_wait(micro, i + 1, i + 1) != 0)
+                return -1;
+            uint64_t end = get_cycles();
+            if (i + 1 < rounds && micro_post_recv(micro, i + 1) != 0)
+                return -1;
+            if (i >= params->warmup_count)
+                rtts[i - params->warmup_count] = (double)(end - start) / (double)clock_rate * 1e6;
+        } else {
+            if (micro_wait(micro, i, i + 1) != 0)
+                return -1;
+            if (i + 1 < rounds && micro_post_recv(micro, i + 1) != 0)
+                return -1;
+            if (micro_post(micro, params->length, i) != 0)
+                return -1;
+        }
+    }
+
+    return micro_wait(micro, rounds, rounds);
+}
+
+/**
+ * Stream count messages of length bytes from rank 0 with params->window in
+ * flight, after warmup ones. Rank 1 keeps receives posted ahead and
+ * answers the last message with an empty send, so the time covers every
+ * delivery, not just the local completions.
+ */
+int run_throughput(struct micro *micro, double *seconds) {
+    struct dccs_parameters *params = micro->params;
+    size_t total = params->count, posted = 0;
+    int rank = micro->transport->rank;
+    uint64_t start = 0;
+
+    micro->sent = micro->received = 0;
+    if (rank == 0) {
+        if (micro_post_recv(micro, total) != 0)
+            return -1;
+        micro_ready(micro);
+        for (size_t i = 0; i < total; i++) {
+            if (i == params->warmup_count)
+                start = get_cycles();
+            if (micro_wait(micro, i < params->window ? 0 : i - params->window + 1, 0) != 0 || micro_post(micro, params->length, i) != 0)
+                return -1;
+        }
+        if (micro_wait(micro, total, 1) != 0)
+            return -1;
+        *seconds = (double)(get_cycles() - start) / (double)clock_rate;
+        return 0;
+    }
+
+    size_t ahead = total < TRANSPORT_QUEUE_DEPTH ? total : TRANSPORT_QUEUE_DEPTH;
+    for (; posted < ahead; posted++) {
+        if (micro_post_recv(micro, posted) != 0)
+            return -1;
+    }
+    micro_ready(micro);
+    while (micro->received < total) {
+        if (micro_wait(micro, 0, micro->received + 1) != 0)
+            return -1;
+        for (; posted < total && posted < micro->received + ahead; posted++) {
+            if (micro_post_recv(micro, posted) != 0)
+                return -1;
+        }
+    }
+
+    return micro_post(micro, 0, total) != 0 || micro_wait(micro, 1, total) != 0 ? -1 : 0;
+}
+
+void report_latency(struct dccs_parameters *params, double *rtts) {
+    size_t n = params->count;
+    double mean = 0;
+
+    qsort(rtts, n, sizeof(double), compare_double);
+    for (size_t i = 0; i < n; i++)
+        mean += rtts[i] / (double)n;
+    log_info("length = %zu, round trips = %zu, RTT min = %.3fµsec, median = %.3fµsec, mean = %.3fµsec, max = %.3fµsec.\n",
+            params->length, n, rtts[0], rtts[n / 2], mean, rtts[n - 1]);
+}
+
+void report_throughput(struct dccs_parameters *params, double seconds) {
+    size_t n = params->count - params->warmup_count;
+    double bytes = (double)n * (double)params->length;
+
+    log_info("length = %zu, messages = %zu, window = %zu, time = %.6fs, throughput = %.3fGbps, rate = %.3fMmsg/s.\n",
+            params->length, n, params->window, seconds, bytes * 8 / seconds / 1e9, (double)n / seconds / 1e6);
+}
+
+int micro_check(struct dccs_parameters *params) {
+    if (params->verb != Send && params->verb != Write && params->verb != WriteImm) {
+        log_error("The transports run -v send, write or write-imm.\n");
+        return -1;
+    }
+    return 0;
+}
+
+int micro_init(struct dccs_transport *transport, struct dccs_parameters *params, void *state) {
+    struct micro *micro = state;
+
+    memset(micro, 0, sizeof(struct micro));
+    micro->transport = transport;
+    micro->params = params;
+    micro->peer = transport->rank == 0 ? 1 : 0;
+    micro->write = params->verb != Send;
+    micro->send_handle = micro->recv_handle = -1;
+    micro->send_buf = malloc_payload(params->length_max, params->seed, (uint64_t)transport->rank, 0);
+    micro->recv_buf = calloc(1, params->length_max);
+    micro->rtts = calloc(params->count, sizeof(double));
+    if (micro->send_buf == NULL || micro->recv_buf == NULL || micro->rtts == NULL)
+        return -1;
+    if ((micro->send_handle = transport_reg(transport, micro->send_buf, params->length_max)) < 0
+            || (micro->recv_handle = transport_reg(transport, micro->recv_buf, params->length_max)) < 0)
+        return -1;
+    return 0;
+}
+
+int micro_run(struct dccs_transport *transport, struct dccs_parameters *params, void *state) {
+    struct micro *micro = state;
+    int rank = transport->rank, rv;
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (rank > 1)
+        return 0;
+
+    memset(micro->recv_buf, 0, params->length);
+    if (params->mode == MODE_LATENCY)
+        rv = run_latency(micro, micro->rtts);
+    else
+        rv = run_throughput(micro, &micro->seconds);
+    if (rv != 0)
+        return -1;
+
+    if (rank == 0 && params->mode == MODE_LATENCY)
+        report_latency(params, micro->rtts);
+    if (rank == 0 && params->mode == MODE_THROUGHPUT)
+        report_throughput(params, micro->seconds);
+
+    // Rank 1 always gets data, rank 0 only the answers of a ping-pong
+    if (rank == 1 || params->mode == MODE_LATENCY) {
+        size_t mismatch = verify_payload(micro->recv_buf, params->length, params->seed, (uint64_t)micro->peer, 0);
+        if (mismatch != params->length) {
+            log_error("rank = %d, data from rank %d mismatches at byte %zu of %zu.\n", rank, micro->peer, mismatch, params->length);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void micro_finish(struct dccs_transport *transport, struct dccs_parameters *params, void *state) {
+    struct micro *micro = state;
+
+    (void)params;
+    transport_dereg(transport, micro->send_handle);
+    transport_dereg(transport, micro->recv_handle);
+    free(micro->send_buf);
+    free(micro->recv_buf);
+    free(micro->rtts);
+}
+
+const struct dccs_transport_tool micro_tool = {
+    .name = "microbenchmark",
+    .check = micro_check,
+    .init = micro_init,
+    .run = micro_run,
+    .finish = micro_finish,
+};
+
+int main(int argc, char *argv[]) {
+    struct micro micro;
+
+    return transport_tool_main(argc, argv, &micro_tool, &micro);
+}
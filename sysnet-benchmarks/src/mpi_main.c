@@ -2,15 +2,19 @@
 
 #define _GNU_SOURCE
 
+#include <limits.h>
+#include <math.h>
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "dccs_mpi.h"
 #include "dccs_utils.h"
 
 #define REPEAT 10
+#define SCHEDULE_STREAM UINT64_MAX    // Payload generator stream drawing random schedules
 
 uint64_t clock_rate = 0;    // Clock ticks per second
 
@@ -27,51 +31,88 @@ void wait_for_gdb(int rank) {
         sleep(5);
 }
 
-int verify_checksum(const void *buf, size_t buffer_size, int rank, int size) {
-    unsigned char digest[SHA_DIGEST_LENGTH];
-    sha1sum(buf, buffer_size, digest);
-    char *digest_hex = bin_to_hex_string(digest, SHA_DIGEST_LENGTH);
+/**
+ * Compare the CRC32C of every chunk of every rank's buffer with the same
+ * chunk at the reference rank, which sent the data, and report each
+ * mismatching rank, message and chunk at rank 0. Chunks are at most one
+ * message long, so a mismatch is localized to a message.
+ */
+int verify_checksums(const void *buf, size_t buffer_size, size_t length, int reference, int rank, int size) {
+    size_t chunk = length < CHECKSUM_CHUNK_BYTES ? length : CHECKSUM_CHUNK_BYTES;
+    size_t chunk_count = checksum_chunk_count(buffer_size, chunk);
+    uint32_t *crcs, *all_crcs = NULL;
+    int rv = 0;
+
+    if (chunk_count > INT_MAX) {
+        log_error("Too many checksum chunks: %zu.\n", chunk_count);
+        return -1;
+    }
+
+    crcs = malloc(chunk_count * sizeof(uint32_t));
+    if (rank == 0)
+        all_crcs = malloc((size_t)size * chunk_count * sizeof(uint32_t));
+
+    // Every rank takes part in the gather, or none does
+    int ok = crcs != NULL && (rank != 0 || all_crcs != NULL);
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    if (!ok) {
+        log_error("rank = %d, failed to allocate %zu checksums.\n", rank, chunk_count);
+        free(all_crcs);
+        free(crcs);
+        return -1;
+    }
+
+    uint64_t start = get_cycles();
+    checksum_chunks(buf, buffer_size, chunk, crcs);
+    MPI_Gather(crcs, (int)chunk_count, MPI_UINT32_T, all_crcs, (int)chunk_count, MPI_UINT32_T, 0, MPI_COMM_WORLD);
+    uint64_t end = get_cycles();
+
     if (rank == 0) {
-        //log_info("Verifying checksum ...\n");
-        MPI_Status status;
-        for (int src = 1; src < size; src++) {
-            unsigned char remote_digest[SHA_DIGEST_LENGTH];
-            MPI_Recv(remote_digest, SHA_DIGEST_LENGTH, MPI_CHAR, src, 0, MPI_COMM_WORLD, &status);
-            if (strncmp((const void *)digest, (const void *)remote_digest, SHA_DIGEST_LENGTH) != 0) {
-                log_error("Incorrect SHA sum from rank %d.\n", src);
-                return -1;
+        const uint32_t *expected = all_crcs + (size_t)reference * chunk_count;
+        size_t bad_chunks = 0;
+        for (int r = 0; r < size; r++) {
+            const uint32_t *actual = all_crcs + (size_t)r * chunk_count;
+            size_t bad = 0;
+            for (size_t c = 0; c < chunk_count; c++) {
+                if (actual[c] == expected[c])
+                    continue;
+
+                size_t chunk_end = (c + 1) * chunk < buffer_size ? (c + 1) * chunk : buffer_size;
+                if (bad++ < CHECKSUM_REPORT_LIMIT)
+                    log_error("Checksum mismatch: rank = %d, message = %zu, bytes = %zu-%zu, crc = %08x, expected = %08x.\n",
+                            r, c * chunk / length, c * chunk, chunk_end - 1, actual[c], expected[c]);
             }
+
+            if (bad > CHECKSUM_REPORT_LIMIT)
+                log_error("Checksum mismatch: rank = %d, %zu more chunks.\n", r, bad - CHECKSUM_REPORT_LIMIT);
+            bad_chunks += bad;
         }
 
-        //log_info("Checksum verified.\n");
-    } else {
-        MPI_Send(digest, SHA_DIGEST_LENGTH, MPI_CHAR, 0, 0, MPI_COMM_WORLD);
+        log_info("Checksums: %zu chunks of %zu B per rank, %zu mismatched, verified in %.3fµsec.\n",
+                chunk_count, chunk, bad_chunks, (double)(end - start) / (double)clock_rate * 1e6);
+        if (bad_chunks > 0)
+            rv = -1;
     }
 
-    free(digest_hex);
-    return 0;
+    free(all_crcs);
+    free(crcs);
+    return rv;
 }
 
 #define HOST_ALL -1
 #define HOST_NOSELF - 2
+#define HOST_NONE -3
 
-int send_messages(int size, int rank, const void *buf, struct dccs_parameters params, int to, size_t *bytes_sent) {
+int send_messages(int size, int rank, const void *buf, struct dccs_parameters params, int to, struct dccs_request_pool *pool, size_t *bytes_sent) {
     if (to != HOST_ALL && to != HOST_NOSELF && (to < 0 || to >= size)) {
         log_error("Invalid send destination %d.\n", to);
         return -1;
     }
 
-    size_t request_count = 1;
-    if (to == HOST_ALL)
-        request_count = (size_t)size;
-    else if (to == HOST_NOSELF)
-        request_count = (size_t)(size - 1);
-    MPI_Request requests[request_count * params.count];
-
-#if !MPI_FIRE_AND_FORGET
-    int done = 0;
+#if MPI_FIRE_AND_FORGET
+    MPI_Request request;
+    (void)pool;
 #endif
-    int request_sent = 0;
     int length = (int)params.length;
     void *sendbuf;
     for (size_t n = 0; n < params.count; n++) {
@@ -82,41 +123,30 @@ int send_messages(int size, int rank, const void *buf, struct dccs_parameters pa
             else if (to != HOST_ALL && to != HOST_NOSELF && dest != to)
                 continue;
 
-            MPI_Isend(sendbuf, length, MPI_BYTE, dest, 0, MPI_COMM_WORLD, requests + request_sent);
 #if MPI_FIRE_AND_FORGET
-            MPI_Request_free(requests + request_sent);
+            MPI_Isend(sendbuf, length, MPI_BYTE, dest, 0, MPI_COMM_WORLD, &request);
+            MPI_Request_free(&request);
+#else
+            MPI_Isend(sendbuf, length, MPI_BYTE, dest, 0, MPI_COMM_WORLD, request_pool_get(pool));
 #endif
             //MPI_Send(sendbuf, length, MPI_BYTE, dest, 0, MPI_COMM_WORLD);
             *bytes_sent += params.length;
-            request_sent++;
         }
     }
 
 #if !MPI_FIRE_AND_FORGET
-    //MPI_Waitall(request_count * params.count, requests, MPI_STATUSES_IGNORE);
-    while (!done) {
-        MPI_Testall(request_count * params.count, requests, &done, MPI_STATUSES_IGNORE);
-    }
+    request_pool_drain(pool);
 #endif
 
     return 0;
 }
 
-int recv_messages(int size, int rank, const void *buf, struct dccs_parameters params, int from, size_t *bytes_recvd) {
+int recv_messages(int size, int rank, const void *buf, struct dccs_parameters params, int from, struct dccs_request_pool *pool, size_t *bytes_recvd) {
     if (from != HOST_ALL && from != HOST_NOSELF && (from < 0 || from >= size)) {
         log_error("Invalid receive source %d.\n", from);
         return -1;
     }
 
-    size_t request_count = 1;
-    if (from == HOST_ALL)
-        request_count = (size_t)size;
-    else if (from == HOST_NOSELF)
-        request_count = (size_t)(size - 1);
-    MPI_Request requests[request_count * params.count];
-
-    int done = 0;
-    int request_sent = 0;
     int length = (int)params.length;
     void *recvbuf;
     for (size_t n = 0; n < params.count; n++) {
@@ -127,22 +157,430 @@ int recv_messages(int size, int rank, const void *buf, struct dccs_parameters pa
             else if (from != HOST_ALL && from != HOST_NOSELF && src != from)
                 continue;
 
-            MPI_Irecv(recvbuf, length, MPI_BYTE, src, 0, MPI_COMM_WORLD, requests + request_sent);
+            MPI_Irecv(recvbuf, length, MPI_BYTE, src, 0, MPI_COMM_WORLD, request_pool_get(pool));
             //MPI_Recv(recvbuf, length, MPI_BYTE, source, 0, MPI_COMM_WORLD, &status);
             *bytes_recvd += params.length;
-            request_sent++;
         }
     }
 
-    //MPI_Waitall(request_count * params.count, requests, MPI_STATUSES_IGNORE);
-    while (!done) {
-        int total_count = (int)(request_count * params.count);
-        MPI_Testall(total_count, requests, &done, MPI_STATUSES_IGNORE);
+    request_pool_drain(pool);
+
+    return 0;
+}
+
+static inline bool host_matches(int host, int target, int rank) {
+    if (target == HOST_NONE)
+        return false;
+    else if (target == HOST_NOSELF)
+        return host != rank;
+    else
+        return target == HOST_ALL || host == target;
+}
+
+/**
+ * Post this rank's sends and receives and wait for all of them, recording
+ * the last completion of each in its pool. Sends and receives advance
+ * independently as their windows free up, so a full window of one never
+ * holds back the other. Sends are always tracked here, whatever
+ * MPI_FIRE_AND_FORGET says.
+ */
+int transfer_messages(int size, int rank, void *buf, struct dccs_parameters params, int to, int from,
+        struct dccs_request_pool *send_pool, struct dccs_request_pool *recv_pool, size_t *bytes_sent, size_t *bytes_recvd) {
+    int length = (int)params.length;
+    size_t total = params.count * (size_t)size;  // (message, host) pairs, in order
+    size_t send_next = 0, recv_next = 0;
+
+    send_pool->last_completion = recv_pool->last_completion = 0;
+    while (send_next < total || recv_next < total
+            || request_pool_in_flight(send_pool) > 0 || request_pool_in_flight(recv_pool) > 0) {
+        for (; recv_next < total && !request_pool_full(recv_pool); recv_next++) {
+            int src = (int)(recv_next % (size_t)size);
+            if (!host_matches(src, from, rank))
+                continue;
+
+            void *recvbuf = (void *)((uint8_t *)buf + recv_next / (size_t)size * params.length);
+            MPI_Irecv(recvbuf, length, MPI_BYTE, src, 0, MPI_COMM_WORLD, request_pool_get(recv_pool));
+            *bytes_recvd += params.length;
+        }
+
+        for (; send_next < total && !request_pool_full(send_pool); send_next++) {
+            int dest = (int)(send_next % (size_t)size);
+            if (!host_matches(dest, to, rank))
+                continue;
+
+            void *sendbuf = (void *)((uint8_t *)buf + send_next / (size_t)size * params.length);
+            MPI_Isend(sendbuf, length, MPI_BYTE, dest, 0, MPI_COMM_WORLD, request_pool_get(send_pool));
+            *bytes_sent += params.length;
+        }
+
+        request_pool_progress(recv_pool);
+        request_pool_progress(send_pool);
+    }
+
+    return 0;
+}
+
+/**
+ * Peers of one N-N round under a --schedule: size - 1 steps, in each of
+ * which every rank sends to one peer and receives from another, so that
+ * every ordered pair of ranks exchanges exactly once per round.
+ */
+struct dccs_schedule {
+    int steps;
+    int *dest;      // Peer to send to, per step
+    int *src;       // Peer to receive from, per step
+    int *label;     // Random schedules: rank relabeling,
+    int *rank_of;   // its inverse,
+    int *shifts;    // and the order of shifts
+};
+
+int schedule_init(struct dccs_schedule *sched, Schedule kind, int size) {
+    memset(sched, 0, sizeof(struct dccs_schedule));
+    if (kind == SCHEDULE_XOR && (size & (size - 1)) != 0) {
+        log_error("XOR schedule requires a power of two ranks, not %d.\n", size);
+        return -1;
+    }
+
+    sched->steps = size - 1;
+    sched->dest = malloc((size_t)size * sizeof(int));
+    sched->src = malloc((size_t)size * sizeof(int));
+    sched->label = malloc((size_t)size * sizeof(int));
+    sched->rank_of = malloc((size_t)size * sizeof(int));
+    sched->shifts = malloc((size_t)size * sizeof(int));
+    if (sched->dest == NULL || sched->src == NULL || sched->label == NULL || sched->rank_of == NULL || sched->shifts == NULL) {
+        log_error("Failed to allocate a schedule for %d ranks.\n", size);
+        return -1;
     }
 
     return 0;
 }
 
+void schedule_destroy(struct dccs_schedule *sched) {
+    free(sched->dest);
+    free(sched->src);
+    free(sched->label);
+    free(sched->rank_of);
+    free(sched->shifts);
+    memset(sched, 0, sizeof(struct dccs_schedule));
+}
+
+/**
+ * Shuffle values 0..count-1 into order with the payload generator, so that
+ * every rank draws the same permutation from the same key.
+ */
+static void shuffle(int *order, int count, uint64_t key) {
+    for (int i = 0; i < count; i++)
+        order[i] = i;
+    for (int i = count - 1; i > 0; i--) {
+        int j = (int)(payload_word(key, (uint64_t)i) % (uint64_t)(i + 1));
+        int t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+}
+
+/**
+ * Fill in this rank's peers for the given round. Shift is the rotor
+ * schedule: in step s, rank r sends to r + s and receives from r - s. XOR
+ * pairs r with r ^ s both ways. Random is the shift schedule over ranks
+ * relabeled by a random permutation, with the shifts in random order,
+ * redrawn every round.
+ */
+void schedule_round(struct dccs_schedule *sched, Schedule kind, int size, int rank, uint64_t seed, size_t round) {
+    int *label = sched->label, *rank_of = sched->rank_of;
+
+    if (kind == SCHEDULE_RANDOM) {
+        uint64_t key = payload_word(payload_key(seed, SCHEDULE_STREAM), round);
+        shuffle(label, size, key);
+        for (int r = 0; r < size; r++)
+            rank_of[label[r]] = r;
+        shuffle(sched->shifts, sched->steps, ~key);
+    }
+
+    for (int step = 0; step < sched->steps; step++) {
+        int shift = step + 1;
+        switch (kind) {
+            case SCHEDULE_XOR:
+                sched->dest[step] = sched->src[step] = rank ^ shift;
+                break;
+            case SCHEDULE_RANDOM:
+                shift = sched->shifts[step] + 1;
+                sched->src[step] = rank_of[(label[rank] - shift + size) % size];
+                sched->dest[step] = rank_of[(label[rank] + shift) % size];
+                break;
+            default:
+                sched->dest[step] = (rank + shift) % size;
+                sched->src[step] = (rank - shift + size) % size;
+                break;
+        }
+    }
+}
+
+/**
+ * Step of the schedule that may be posted now. Completion pacing opens a
+ * step once everything of the previous one has completed. Slot pacing opens
+ * step s at start + s slots of this rank's clock, late or not, and counts
+ * the steps still outstanding when their slot ended.
+ */
+static int schedule_open_step(struct dccs_parameters *params, int open, int steps, size_t count, uint64_t start,
+        size_t send_next, size_t recv_next, struct dccs_request_pool *send_pool, struct dccs_request_pool *recv_pool, size_t *late_steps) {
+    size_t posted = send_next < recv_next ? send_next : recv_next;
+    bool idle = request_pool_in_flight(send_pool) == 0 && request_pool_in_flight(recv_pool) == 0;
+
+    if (params->pacing == PACING_COMPLETION)
+        return posted >= (size_t)(open + 1) * count && idle ? open + 1 : open;
+
+    uint64_t now = get_cycles();
+    while (open + 1 < steps && now >= start + (uint64_t)(open + 1) * params->slot_us * clock_rate / MILLION) {
+        if (posted < (size_t)(open + 1) * count || !idle)
+            (*late_steps)++;
+        open++;
+    }
+
+    return open;
+}
+
+/**
+ * Run one round of the N-N schedule: each step exchanges count messages
+ * with that step's peers, through the same windows as transfer_messages.
+ * Steps open as --pacing says, relative to start on this rank's clock.
+ */
+int transfer_scheduled(void *buf, struct dccs_parameters params, struct dccs_schedule *sched, uint64_t start,
+        struct dccs_request_pool *send_pool, struct dccs_request_pool *recv_pool, size_t *bytes_sent, size_t *bytes_recvd, size_t *late_steps) {
+    int length = (int)params.length;
+    size_t total = params.count * (size_t)sched->steps;    // (step, message) pairs, in order
+    size_t send_next = 0, recv_next = 0;
+    int open = 0;
+
+    send_pool->last_completion = recv_pool->last_completion = 0;
+    while (get_cycles() < start)
+        ;
+
+    while (send_next < total || recv_next < total
+            || request_pool_in_flight(send_pool) > 0 || request_pool_in_flight(recv_pool) > 0) {
+        if (open + 1 < sched->steps)
+            open = schedule_open_step(&params, open, sched->steps, params.count, start, send_next, recv_next, send_pool, recv_pool, late_steps);
+        size_t limit = (size_t)(open + 1) * params.count;
+
+        for (; recv_next < total && recv_next < limit && !request_pool_full(recv_pool); recv_next++) {
+            void *recvbuf = (void *)((uint8_t *)buf + recv_next % params.count * params.length);
+            MPI_Irecv(recvbuf, length, MPI_BYTE, sched->src[recv_next / params.count], 0, MPI_COMM_WORLD, request_pool_get(recv_pool));
+            *bytes_recvd += params.length;
+        }
+
+        for (; send_next < total && send_next < limit && !request_pool_full(send_pool); send_next++) {
+            void *sendbuf = (void *)((uint8_t *)buf + send_next % params.count * params.length);
+            MPI_Isend(sendbuf, length, MPI_BYTE, sched->dest[send_next / params.count], 0, MPI_COMM_WORLD, request_pool_get(send_pool));
+            *bytes_sent += params.length;
+        }
+
+        request_pool_progress(recv_pool);
+        request_pool_progress(send_pool);
+    }
+
+    // The last step is late if it ran past the end of its slot
+    uint64_t end = send_pool->last_completion > recv_pool->last_completion ? send_pool->last_completion : recv_pool->last_completion;
+    if (params.pacing == PACING_SLOT && end > start + (uint64_t)sched->steps * params.slot_us * clock_rate / MILLION)
+        (*late_steps)++;
+
+    return 0;
+}
+
+/* Round summaries */
+
+/**
+ * One rank's measurement of a round, gathered at rank 0.
+ */
+struct dccs_rank_stats {
+    double bytes;       // Bytes received, 0 on ranks that only send
+    double elapsed;     // Time to the rank's last receive, in µsec
+    double span;        // Time to the rank's last completion of any kind, in µsec
+};
+
+/**
+ * Summary of every round, one record per (length, round) across ranks,
+ * written by rank 0 to --output.
+ */
+struct dccs_summary {
+    FILE *file;
+    Format format;
+    size_t records;
+    struct dccs_rank_stats *ranks;  // Gathered from every rank
+    double *elapsed;                // Receiving ranks only
+    double *throughput;
+};
+
+struct dccs_spread {
+    double min;
+    double mean;
+    double max;
+    double stdev;
+};
+
+int summary_open(struct dccs_summary *summary, struct dccs_parameters *params, int rank, int size) {
+    memset(summary, 0, sizeof(struct dccs_summary));
+    if (rank != 0)
+        return 0;
+
+    summary->format = params->format;
+    summary->ranks = malloc((size_t)size * sizeof(struct dccs_rank_stats));
+    summary->elapsed = malloc((size_t)size * sizeof(double));
+    summary->throughput = malloc((size_t)size * sizeof(double));
+    if (summary->ranks == NULL || summary->elapsed == NULL || summary->throughput == NULL) {
+        log_error("Failed to allocate a summary for %d ranks.\n", size);
+        return -1;
+    }
+
+    if (params->output == NULL)
+        return 0;
+    if ((summary->file = fopen(params->output, "w")) == NULL) {
+        log_perror("Failed to open the summary file");
+        return -1;
+    }
+
+    if (summary->format == FORMAT_CSV)
+        fprintf(summary->file, "length,direction,schedule,timing,window,round,ranks,bytes,"
+                "elapsed_min,elapsed_mean,elapsed_max,elapsed_stdev,"
+                "throughput_min,throughput_mean,throughput_max,throughput_stdev,"
+                "aggregate_elapsed,aggregate_throughput\n");
+    else
+        fprintf(summary->file, "[");
+
+    return 0;
+}
+
+void summary_close(struct dccs_summary *summary) {
+    if (summary->file != NULL) {
+        if (summary->format == FORMAT_JSON)
+            fprintf(summary->file, "\n]\n");
+        fclose(summary->file);
+        log_info("Summary: %zu records written.\n", summary->records);
+    }
+
+    free(summary->ranks);
+    free(summary->elapsed);
+    free(summary->throughput);
+    memset(summary, 0, sizeof(struct dccs_summary));
+}
+
+static struct dccs_spread spread(const double *values, size_t count) {
+    struct dccs_spread s = { values[0], 0, values[0], 0 };
+
+    for (size_t i = 0; i < count; i++) {
+        s.min = values[i] < s.min ? values[i] : s.min;
+        s.max = values[i] > s.max ? values[i] : s.max;
+        s.mean += values[i] / (double)count;
+    }
+    for (size_t i = 0; i < count; i++)
+        s.stdev += (values[i] - s.mean) * (values[i] - s.mean) / (double)count;
+    s.stdev = sqrt(s.stdev);
+
+    return s;
+}
+
+/**
+ * Gather every rank's stats of a round at rank 0, log the aggregate
+ * delivered throughput up to the last completion on any rank, and write
+ * the round's record with the spread of elapsed time and throughput
+ * across the receiving ranks.
+ */
+void summarize_round(struct dccs_summary *summary, size_t r, int rank, int size, struct dccs_parameters params, struct dccs_rank_stats *stats) {
+    double total_bytes = 0, last_span = 0;
+    size_t receivers = 0;
+
+    MPI_Gather(stats, 3, MPI_DOUBLE, summary->ranks, 3, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (rank != 0)
+        return;
+
+    for (int i = 0; i < size; i++) {
+        struct dccs_rank_stats *s = summary->ranks + i;
+        last_span = s->span > last_span ? s->span : last_span;
+        if (s->bytes == 0)
+            continue;
+
+        summary->elapsed[receivers] = s->elapsed;
+        summary->throughput[receivers] = s->bytes * 8 / (s->elapsed / 1e6) / (1024 * 1024 * 1024);
+        total_bytes += s->bytes;
+        receivers++;
+    }
+    if (receivers == 0)
+        return;
+
+    double throughput_gbits = total_bytes * 8 / (last_span / 1e6) / (1024 * 1024 * 1024);
+    log_info("round = %zu, aggregate, window = %zu, bytes recv'd = %.0f, elapsed = %.3fµsec, throughput = %.3f gbits.\n", r, params.window, total_bytes, last_span, throughput_gbits);
+    if (summary->file == NULL)
+        return;
+
+    struct dccs_spread elapsed = spread(summary->elapsed, receivers);
+    struct dccs_spread throughput = spread(summary->throughput, receivers);
+    const char *timing = params.timing == TIMING_EPOCH ? "epoch" : "local";
+    if (summary->format == FORMAT_CSV)
+        fprintf(summary->file, "%zu,%s,%s,%s,%zu,%zu,%zu,%.0f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+                params.length, direction_name(params.direction), schedule_name(params.schedule), timing, params.window, r, receivers, total_bytes,
+                elapsed.min, elapsed.mean, elapsed.max, elapsed.stdev,
+                throughput.min, throughput.mean, throughput.max, throughput.stdev, last_span, throughput_gbits);
+    else
+        fprintf(summary->file, "%s\n  {\"length\": %zu, \"direction\": \"%s\", \"schedule\": \"%s\", \"timing\": \"%s\", "
+                "\"window\": %zu, \"round\": %zu, \"ranks\": %zu, \"bytes\": %.0f, "
+                "\"elapsed\": {\"min\": %.3f, \"mean\": %.3f, \"max\": %.3f, \"stdev\": %.3f}, "
+                "\"throughput\": {\"min\": %.3f, \"mean\": %.3f, \"max\": %.3f, \"stdev\": %.3f}, "
+                "\"aggregate\": {\"elapsed\": %.3f, \"throughput\": %.3f}}",
+                summary->records > 0 ? "," : "",
+                params.length, direction_name(params.direction), schedule_name(params.schedule), timing, params.window, r, receivers, total_bytes,
+                elapsed.min, elapsed.mean, elapsed.max, elapsed.stdev,
+                throughput.min, throughput.mean, throughput.max, throughput.stdev, last_span, throughput_gbits);
+    summary->records++;
+}
+
+/**
+ * Report a locally timed round: the rank's receive throughput, and the
+ * round's summary over the slowest receiver's time.
+ */
+void report_local_round(struct dccs_summary *summary, size_t r, int rank, int size, struct dccs_parameters params, uint64_t elapsed_cycles, size_t bytes_recvd) {
+    double elapsed = (double)elapsed_cycles / (double)clock_rate;
+
+    // Per rank with -V only, at scale rank 0's aggregate line is the output
+    if (params.verbose && bytes_recvd > 0) {
+        double throughput_gbits = (double)bytes_recvd * 8 / elapsed / (1024 * 1024 * 1024);
+        log_info("round = %zu, rank = %d, window = %zu, bytes recv'd = %zu, elapsed = %.3fµsec, throughput = %.3f gbits.\n", r, rank, params.window, bytes_recvd, elapsed * 1e6, throughput_gbits);
+    }
+
+    struct dccs_rank_stats stats = { (double)bytes_recvd, elapsed * 1e6, elapsed * 1e6 };
+    summarize_round(summary, r, rank, size, params, &stats);
+}
+
+/**
+ * Report a round timed against the common epoch: per-rank send and receive
+ * throughput up to the rank's last completion, and the round's summary up
+ * to the last completion on any rank.
+ */
+void report_epoch_round(struct dccs_summary *summary, size_t r, int rank, int size, struct dccs_parameters params, uint64_t epoch, int64_t clock_offset,
+        struct dccs_request_pool *send_pool, struct dccs_request_pool *recv_pool, size_t bytes_sent, size_t bytes_recvd) {
+    uint64_t send_end = 0, recv_end = 0, end;
+    struct dccs_rank_stats stats = { (double)bytes_recvd, 0, 0 };
+
+    if (bytes_sent > 0) {
+        send_end = (uint64_t)((int64_t)send_pool->last_completion + clock_offset);
+        double elapsed = (double)(send_end - epoch) / (double)clock_rate;
+        double throughput_gbits = (double)bytes_sent * 8 / elapsed / (1024 * 1024 * 1024);
+        if (params.verbose)
+            log_info("round = %zu, rank = %d, window = %zu, bytes sent = %zu, elapsed = %.3fµsec, throughput = %.3f gbits.\n", r, rank, params.window, bytes_sent, elapsed * 1e6, throughput_gbits);
+    }
+
+    if (bytes_recvd > 0) {
+        recv_end = (uint64_t)((int64_t)recv_pool->last_completion + clock_offset);
+        double elapsed = (double)(recv_end - epoch) / (double)clock_rate;
+        double throughput_gbits = (double)bytes_recvd * 8 / elapsed / (1024 * 1024 * 1024);
+        if (params.verbose)
+            log_info("round = %zu, rank = %d, window = %zu, bytes recv'd = %zu, elapsed = %.3fµsec, throughput = %.3f gbits.\n", r, rank, params.window, bytes_recvd, elapsed * 1e6, throughput_gbits);
+        stats.elapsed = elapsed * 1e6;
+    }
+
+    end = send_end > recv_end ? send_end : recv_end;
+    stats.span = end > epoch ? (double)(end - epoch) / (double)clock_rate * 1e6 : 0;
+    summarize_round(summary, r, rank, size, params, &stats);
+}
+
 int run(int size, int rank, struct dccs_parameters params) {
     int rv = 0;
     void *buf;
@@ -152,8 +590,26 @@ int run(int size, int rank, struct dccs_parameters params) {
 
     size_t bytes_sent, bytes_recvd;
     size_t buffer_size = params.length * params.count;
-
-    buf = malloc_random(buffer_size);
+    struct dccs_request_pool send_pool, recv_pool;
+    struct dccs_schedule sched;
+    struct dccs_summary summary;
+    size_t rounds = 0;
+
+    if (request_pool_init(&send_pool, params.window) != 0 || request_pool_init(&recv_pool, params.window) != 0)
+        exit(EXIT_FAILURE);
+
+    memset(&sched, 0, sizeof(struct dccs_schedule));
+    if (params.schedule != SCHEDULE_ALL && schedule_init(&sched, params.schedule, size) != 0)
+        exit(EXIT_FAILURE);
+    // Only rank 0 opens the summary, the others would wait on it in the first gather
+    int opened = summary_open(&summary, &params, rank, size);
+    MPI_Bcast(&opened, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (opened != 0)
+        exit(EXIT_FAILURE);
+
+    int64_t clock_offset = 0;
+    if (params.timing == TIMING_EPOCH)
+        clock_offset = sync_clock_offset(size, rank);
 
     switch (params.direction) {
         case DIR_OUT:
@@ -180,39 +636,107 @@ int run(int size, int rank, struct dccs_parameters params) {
             break;
     }
 
+    // Senders all hold payload stream 0, receive-only ranks start on their own
+    buf = malloc_payload(buffer_size, params.seed, should_send ? 0 : (uint64_t)rank + 1, 0);
+    if (buf == NULL) {
+        log_error("Failed to allocate a %zu B buffer.\n", buffer_size);
+        exit(EXIT_FAILURE);
+    }
+
     //MPI_Barrier(MPI_COMM_WORLD);
     //start = get_cycles();
 
-    for (size_t r = 0; r < REPEAT; r++) {
-        MPI_Barrier(MPI_COMM_WORLD);
+    // One buffer of the largest length serves the whole --length-range sweep
+    for (size_t length = params.length_min; length != 0; length = next_length(&params, length)) {
+        params.length = length;
+        if (rank == 0 && params.length_min != params.length_max)
+            log_info("Length = %zu ...\n", length);
+
+        for (size_t r = 0; r < REPEAT; r++) {
+            MPI_Barrier(MPI_COMM_WORLD);
+
+            //buf = malloc_payload(buffer_size, params.seed, 0, 0);
+            bytes_sent = bytes_recvd = 0;
+
+            if (params.schedule != SCHEDULE_ALL) {
+                uint64_t epoch = 0;
+                size_t late_steps = 0;
+                schedule_round(&sched, params.schedule, size, rank, params.seed, rounds++);
+                if (params.timing == TIMING_EPOCH) {
+                    epoch = wait_for_epoch(rank, clock_offset);
+                    start = (uint64_t)((int64_t)epoch - clock_offset);
+                } else {
+                    start = get_cycles();
+                }
+
+                transfer_scheduled(buf, params, &sched, start, &send_pool, &recv_pool, &bytes_sent, &bytes_recvd, &late_steps);
+                if (params.timing == TIMING_EPOCH)
+                    report_epoch_round(&summary, r, rank, size, params, epoch, clock_offset, &send_pool, &recv_pool, bytes_sent, bytes_recvd);
+                else
+                    report_local_round(&summary, r, rank, size, params, recv_pool.last_completion - start, bytes_recvd);
+                if (late_steps > 0)
+                    log_warning("round = %zu, rank = %d, %zu of %d steps overran their %zuµsec slot.\n", r, rank, late_steps, sched.steps, params.slot_us);
+                continue;
+            }
 
-        //buf = malloc_random(buffer_size);
-        bytes_sent = bytes_recvd = 0;
+            if (params.timing == TIMING_EPOCH) {
+                uint64_t epoch = wait_for_epoch(rank, clock_offset);
+                transfer_messages(size, rank, buf, params, should_send ? send_target : HOST_NONE, should_recv ? recv_source : HOST_NONE,
+                        &send_pool, &recv_pool, &bytes_sent, &bytes_recvd);
+                report_epoch_round(&summary, r, rank, size, params, epoch, clock_offset, &send_pool, &recv_pool, bytes_sent, bytes_recvd);
+                continue;
+            }
 
-        if (should_send) {
-            //start = get_cycles();
-            send_messages(size, rank, buf, params, send_target, &bytes_sent);
-            //end = get_cycles();
-        }
+            // Sends wait on a full window, so a rank that also receives takes
+            // in its peers' messages while its own are waiting
+            if (should_send && should_recv) {
+                start = get_cycles();
+                transfer_messages(size, rank, buf, params, send_target, recv_source, &send_pool, &recv_pool, &bytes_sent, &bytes_recvd);
+                report_local_round(&summary, r, rank, size, params, recv_pool.last_completion - start, bytes_recvd);
+                continue;
+            }
 
-        if (should_recv) {
-            start = get_cycles();
-            recv_messages(size, rank, buf, params, recv_source, &bytes_recvd);
-            end = get_cycles();
-        }
+            if (should_send) {
+                //start = get_cycles();
+                send_messages(size, rank, buf, params, send_target, &send_pool, &bytes_sent);
+                //end = get_cycles();
+            }
+
+            if (should_recv) {
+                start = get_cycles();
+                recv_messages(size, rank, buf, params, recv_source, &recv_pool, &bytes_recvd);
+                end = get_cycles();
+            }
+
+            report_local_round(&summary, r, rank, size, params, should_recv ? end - start : 0, bytes_recvd);
 
-        if (should_recv) {
-            double elapsed = (double)(end - start) / (double)clock_rate;
-            double elapsed_usec = elapsed * 1e6;
-            double throughput_gbits = (double)bytes_recvd * 8 / elapsed / (1024 * 1024 * 1024);
-            log_info("round = %zu, rank = %d, bytes recv'd = %zu, elapsed = %.3fµsec, throughput = %.3f gbits.\n", r, rank, bytes_recvd, elapsed_usec, throughput_gbits);
+            //verify_checksums(buf, buffer_size, params.length, reference, rank, size);
+            //free(buf);
         }
+    }
 
-        //verify_checksum(buf, buffer_size, rank, size);
-        //free(buf);
+    // Fire-and-forget sends are only known to be delivered, and their
+    // buffer free to release, once every receiver is done
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    // The last length of the sweep determines what was overwritten
+    size_t received_size = params.length * params.count;
+    if (should_recv) {
+        size_t mismatch = verify_payload(buf, received_size, params.seed, 0, 0);
+        if (mismatch != received_size) {
+            log_error("rank = %d, payload mismatch at byte %zu (message %zu) of %zu.\n", rank, mismatch, mismatch / params.length, received_size);
+            rv = -1;
+        }
     }
 
-    verify_checksum(buf, buffer_size, rank, size);
+    // Ranks that send hold the data every other rank should have received
+    int reference = params.direction == DIR_IN && size > 1 ? 1 : 0;
+    if (verify_checksums(buf, received_size, params.length, reference, rank, size) != 0)
+        rv = -1;
+    summary_close(&summary);
+    schedule_destroy(&sched);
+    request_pool_destroy(&send_pool);
+    request_pool_destroy(&recv_pool);
     free(buf);
 
 /*
@@ -232,11 +756,11 @@ int main(int argc, char *argv[]) {
 
     parse_args(argc, argv, &params);
     print_parameters(&params);
-    dccs_init();
 
     MPI_Init(&argc, &argv);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    dccs_init(&params, rank, affinity_local_rank(MPI_COMM_WORLD));
 
     //wait_for_gdb(rank);
 
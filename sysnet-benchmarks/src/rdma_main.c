@@ -9,10 +9,17 @@
 #include "dccs_rdma.h"
 
 uint64_t clock_rate = 0;    // Clock ticks per second
+struct dccs_cq_wait cq_wait;    // How completions are waited for
+struct dccs_mr_cache mr_cache;  // Control message registrations
 
 int run(struct dccs_parameters params) {
-    struct rdma_cm_id *listen_id = NULL, *id;
+    struct rdma_cm_id *listen_id = NULL, **ids;
     struct dccs_request *requests;
+    struct dccs_client_thread *threads = NULL;
+    struct dccs_shared_recv shared;
+    struct dccs_recv_ring ring;
+    uint64_t *starts = NULL, *ends = NULL;
+    size_t connected = 0, allocated = 0;
     int rv = 0;
 
     Role role = params.server == NULL ? ROLE_SERVER : ROLE_CLIENT;
@@ -21,109 +28,190 @@ int run(struct dccs_parameters params) {
     else
         log_info("Running in server mode ...\n");
 
+    // One connection per QP, each with its own slice of a client's requests
+    size_t per_client = params.threads * params.qps;
+    size_t connections = (role == ROLE_SERVER ? params.clients : 1) * per_client;
+    struct dccs_parameters slice_params = params;
+    slice_params.count = params.count / per_client;
+    size_t slice = slice_params.count;
+
+    memset(&shared, 0, sizeof shared);
+    memset(&ring, 0, sizeof ring);
+    struct dccs_shared_recv *shared_recv = role == ROLE_SERVER && params.srq ? &shared : NULL;
+
+    if ((ids = calloc(connections, sizeof(struct rdma_cm_id *))) == NULL) {
+        log_error("Failed to allocate %zu connections.\n", connections);
+        rv = -1;
+        goto end;
+    }
     if (role == ROLE_CLIENT) {
-        if ((rv = dccs_connect(&id, params.server, params.port)) != 0)
-            goto end;
+        for (; connected < connections; connected++) {
+            if ((rv = dccs_connect(ids + connected, params.server, params.port, (uint32_t)params.max_inline)) != 0)
+                goto out_disconnect;
+        }
     } else {    // role == ROLE_SERVER
-        if ((rv = dccs_listen(&listen_id, &id, params.port)) != 0)
+        if ((rv = dccs_listen(&listen_id, ids, params.port, (uint32_t)params.max_inline, shared_recv)) != 0)
             goto end;
+        for (connected = 1; connected < connections; connected++) {
+            if ((rv = dccs_accept(listen_id, ids + connected, (uint32_t)params.max_inline, shared_recv)) != 0)
+                goto out_disconnect;
+        }
+        print_recv_resources(&params, connections);
     }
 
+    params.inline_limit = slice_params.inline_limit = dccs_inline_limit(ids[0]);
+    log_info("Inline data: up to %zu B.\n", params.inline_limit);
+
     log_debug("Allocating buffer ...\n");
-    size_t requests_size = params.count * sizeof(struct dccs_request);
-    requests = malloc(requests_size);
-    memset(requests, 0, requests_size);
-    if ((rv = allocate_buffer(id, requests, params)) != 0) {
-        log_error("Failed to allocate buffers.\n");
-        goto out_disconnect;
+    size_t requests_size = connections * slice * sizeof(struct dccs_request);
+    requests = calloc(1, requests_size);
+    threads = calloc(params.threads, sizeof(struct dccs_client_thread));
+    starts = calloc(params.clients, sizeof(uint64_t));
+    ends = calloc(params.clients, sizeof(uint64_t));
+    if (requests == NULL || threads == NULL || starts == NULL || ends == NULL) {
+        log_error("Failed to allocate requests for %zu connections and %zu threads.\n", connections, params.threads);
+        rv = -1;
+        goto out_deallocate_buffer;
     }
-
-    if (role == ROLE_CLIENT) {
-        log_debug("Getting remote MR info ...\n");
-        if ((rv = get_remote_mr_info(id, requests, params.count)) < 0) {
-            log_debug("rv = %d.\n", rv);
-            log_error("Failed to get remote MR info.\n");
-            goto out_deallocate_buffer;
-        }
-    } else {    // role == ROLE_SERVER
-        log_debug("Sending local MR info ...\n");
-        if ((rv = send_local_mr_info(id, requests, params.count, params.length)) < 0) {
-            log_error("Failed to get remote MR info.\n");
+    for (; allocated < connections; allocated++) {
+        if ((rv = allocate_buffer(ids[allocated], requests + allocated * slice, slice_params)) != 0) {
+            log_error("Failed to allocate buffers.\n");
             goto out_deallocate_buffer;
         }
     }
 
-    for (size_t n = 0; n < DEFAULT_REPEAT_COUNT; n++) {
-        log_info("Round %zu.\n", n + 1);
+    // Two-sided requests land in a ring of receives posted up front
+    if (role == ROLE_SERVER && uses_recv_ring(params.verb) && (rv = ring_init(&ring, ids, connections, shared_recv, requests, &params)) != 0) {
+        log_error("Failed to set up the receive ring.\n");
+        goto out_deallocate_buffer;
+    }
 
+    for (size_t c = 0; c < connections; c++) {
+        struct dccs_request *slice_requests = requests + c * slice;
         if (role == ROLE_CLIENT) {
-            // Client is active in RDMA experiments, i.e. requester.
-
-/*
-            log_debug("Sending RDMA requests ...\n");
-            if ((rv = send_requests(id, requests, params.count)) < 0) {
-                log_error("Failed to send all requests.\n");
+            log_debug("Getting remote MR info ...\n");
+            if ((rv = get_remote_mr_info(ids[c], slice_requests, slice, params.mr_count, params.length)) < 0) {
+                log_debug("rv = %d.\n", rv);
+                log_error("Failed to get remote MR info.\n");
                 goto out_deallocate_buffer;
             }
-
-            log_debug("Waiting for RDMA requests completion.\n");
-            if ((rv = wait_requests(id, requests, params.count)) < 0) {
-                log_error("Failed to send comp all requests.\n");
+        } else {    // role == ROLE_SERVER
+            log_debug("Sending local MR info ...\n");
+            if ((rv = send_local_mr_info(ids[c], slice_requests, slice, params.mr_count)) < 0) {
+                log_error("Failed to get remote MR info.\n");
                 goto out_deallocate_buffer;
             }
- */
+        }
+    }
 
-            log_info("Sending and waiting for RDMA requests ...\n");
-            if ((rv = send_and_wait_requests(id, requests, &params)) < 0) {
-                log_error("Failed to send and send comp all requests.\n");
-                goto out_end_request;
+    for (size_t length = params.length_min; length != 0; length = next_length(&params, length)) {
+        params.length = slice_params.length = length;
+        for (size_t c = 0; c < connections; c++)
+            set_request_length(requests + c * slice, &slice_params);
+        if (params.length_min != params.length_max)
+            log_info("Length = %zu ...\n", length);
+
+        for (size_t n = 0; n < DEFAULT_REPEAT_COUNT; n++) {
+            struct dccs_cpu_sample round_start;
+            log_info("Round %zu.\n", n + 1);
+
+            // The server starts all of its clients together
+            if (role == ROLE_CLIENT) {
+                log_debug("Waiting for start message ...\n");
+                char buf[SYNC_START_MESSAGE_LENGTH] = {0};
+                if ((rv = recv_message(ids[0], buf, SYNC_START_MESSAGE_LENGTH)) < 0) {
+                    log_error("Failed to recv start message.\n");
+                    goto out_deallocate_buffer;
+                }
+            }
+            sample_cpu(&round_start);
+
+            if (role == ROLE_CLIENT) {
+                // Client is active in RDMA experiments, i.e. requester.
+
+                log_info("Sending and waiting for RDMA requests ...\n");
+                if (connections == 1)
+                    rv = send_and_wait_requests(ids[0], requests, &params);
+                else
+                    rv = send_and_wait_requests_threaded(ids, requests, &params, threads);
+                if (rv < 0) {
+                    log_error("Failed to send and send comp all requests.\n");
+                    goto out_end_request;
+                }
+            } else {    // role == ROLE_SERVER
+                // Server is passive in RDMA experiments, i.e. responder. It
+                // only starts the round and waits for each client's end,
+                // taking in two-sided requests on the way.
+                log_debug("Waiting for end messages ...\n");
+                if (uses_recv_ring(params.verb))
+                    rv = serve_ring_round(&ring, ids, params.clients, starts, ends);
+                else
+                    rv = serve_round(ids, params.clients, shared_recv, starts, ends);
+                if (rv < 0) {
+                    log_error("Failed to recv terminating messages.\n");
+                    goto out_deallocate_buffer;
+                }
             }
-        } else {    // role == ROLE_SERVER
-            // Server is passive in RDMA experiments, i.e. responder.
-        }
 
 out_end_request:
-        // Synchronize end of a round
-        if (role == ROLE_CLIENT) {
-            log_debug("Sending terminating message ...\n");
-            char buf[SYNC_END_MESSAGE_LENGTH] = SYNC_END_MESSAGE;
-            if ((rv = send_message(id, buf, SYNC_END_MESSAGE_LENGTH)) < 0) {
-                log_error("Failed to send terminating message.\n");
-                goto out_deallocate_buffer;
+            // Synchronize end of a round
+            if (role == ROLE_CLIENT) {
+                log_debug("Sending terminating message ...\n");
+                char buf[SYNC_END_MESSAGE_LENGTH] = SYNC_END_MESSAGE;
+                if ((rv = send_message(ids[0], buf, SYNC_END_MESSAGE_LENGTH)) < 0) {
+                    log_error("Failed to send terminating message.\n");
+                    goto out_deallocate_buffer;
+                }
             }
-        } else {    // role == ROLE_SERVER
-            log_debug("Waiting for end message ...\n");
-            char buf[SYNC_END_MESSAGE_LENGTH] = {0};
-            if ((rv = recv_message(id, buf, SYNC_END_MESSAGE_LENGTH)) < 0) {
-                log_error("Failed to recv terminating message.\n");
-                goto out_deallocate_buffer;
-            }
-        }
 
-        // Print stats
-        print_sha1sum(requests, params.count);
-        if (role == ROLE_CLIENT) {
-            switch (params.mode) {
-                case MODE_LATENCY:
-                    print_latency_report(&params, requests);
-                    break;
-                case MODE_THROUGHPUT:
-                    print_throughput_report(&params, requests);
-                    break;
+            // Print stats
+            print_completion_report(&params, &round_start);
+            if (role == ROLE_SERVER)
+                print_client_report(&params, starts, ends);
+            if (role == ROLE_SERVER && uses_recv_ring(params.verb))
+                print_ring_report(&ring);
+            for (size_t c = 0; c < connections; c++)
+                verify_request_checksums(ids[c], requests + c * slice, &slice_params, role);
+            if (role == ROLE_CLIENT) {
+                switch (params.mode) {
+                    case MODE_LATENCY:
+                        print_latency_report(&params, requests);
+                        break;
+                    case MODE_THROUGHPUT:
+                        if (connections == 1)
+                            print_throughput_report(&params, requests);
+                        else
+                            print_thread_report(&params, threads);
+                        break;
+                }
             }
         }
     }
 
 out_deallocate_buffer:
     log_debug("de-allocating buffer\n");
-    deallocate_buffer(requests, params);
+    ring_destroy(&ring);
+    for (size_t c = 0; c < allocated; c++)
+        deallocate_buffer(requests + c * slice, slice_params);
+    free(requests);
+    free(threads);
+    free(starts);
+    free(ends);
 out_disconnect:
     log_debug("Disconnecting\n");
-    if (role == ROLE_CLIENT)
-        dccs_client_disconnect(id);
-    else    // role == ROLE_SERVER
-        dccs_server_disconnect(id, listen_id);
+    mr_cache_flush();
+    if (role == ROLE_CLIENT) {
+        for (size_t c = 0; c < connected; c++)
+            dccs_client_disconnect(ids[c]);
+    } else {    // role == ROLE_SERVER
+        // Connections go like a client's, before what they share
+        for (size_t c = 0; c < connected; c++)
+            dccs_client_disconnect(ids[c]);
+        shared_recv_destroy(&shared);
+        rdma_destroy_ep(listen_id);
+    }
 end:
+    free(ids);
     return rv;
 }
 
@@ -132,7 +220,8 @@ int main(int argc, char *argv[]) {
 
     parse_args(argc, argv, &params);
     print_parameters(&params);
-    dccs_init();
+    dccs_init(&params, 0, 0);
+    dccs_cq_wait_init(&params);
 
     return run(params);
 }
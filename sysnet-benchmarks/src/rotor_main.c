@@ -0,0 +1,122 @@
+// RotorLB tool
+//
+// MPI starts the ranks, sets up the --transport, syncs the clocks to a
+// common start and gathers the results. Slots are timed by each rank on its
+// own clock and carried by writes of the transport. For verbs and TCP, host
+// names must resolve to addresses of the interfaces to use.
+
+#define _GNU_SOURCE
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dccs_mpi.h"
+#include "dccs_utils.h"
+#include "dccs_transport.h"
+#include "dccs_rotor.h"
+
+uint64_t clock_rate = 0;    // Clock ticks per second
+struct dccs_cq_wait cq_wait;    // How completions are waited for
+struct dccs_mr_cache mr_cache;  // Control message registrations
+
+/**
+ * Gather every rank's delivery times of the measured slots at rank 0 and
+ * print them as rlb_v1 prints its comm node times, one row per rank in
+ * µsec from the slot's start, followed by their spread.
+ */
+void report_run(struct dccs_rotor *rotor, struct dccs_parameters *params, size_t warmup) {
+    size_t slots = rotor->slots - warmup;
+    double *times = malloc(slots * sizeof(double)), *all_times = NULL;
+    unsigned long counts[2] = { rotor->late_posts, rotor->misordered }, all_counts[2];
+
+    if (rotor->rank == 0)
+        all_times = malloc((size_t)rotor->size * slots * sizeof(double));
+    if (times == NULL || (rotor->rank == 0 && all_times == NULL)) {
+        log_error("rank = %d, failed to allocate the delivery times of %zu slots.\n", rotor->rank, slots);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+
+    for (size_t s = 0; s < slots; s++)
+        times[s] = (double)rotor->deliveries[warmup + s] / (double)clock_rate * 1e6;
+    MPI_Gather(times, (int)slots, MPI_DOUBLE, all_times, (int)slots, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    MPI_Reduce(counts, all_counts, 2, MPI_UNSIGNED_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (rotor->rank == 0) {
+        printf("Delivery times relative to slot start [rank, slot]:\n");
+        for (int r = 0; r < rotor->size; r++) {
+            for (size_t s = 0; s < slots; s++)
+                printf("%.0f ", all_times[(size_t)r * slots + s]);
+            printf("\n");
+        }
+        printf("\n");
+
+        size_t n = (size_t)rotor->size * slots;
+        double mean = 0;
+        qsort(all_times, n, sizeof(double), compare_double);
+        for (size_t i = 0; i < n; i++)
+            mean += all_times[i] / (double)n;
+        log_info("length = %zu, slot = %zuµsec, slots = %zu, delivery min = %.3fµsec, median = %.3fµsec, mean = %.3fµsec, max = %.3fµsec.\n",
+                params->length, params->slot_us, slots, all_times[0], all_times[n / 2], mean, all_times[n - 1]);
+        if (all_counts[0] > 0 || all_counts[1] > 0)
+            log_warning("%lu writes posted after their slot was over, %lu notifications out of order.\n", all_counts[0], all_counts[1]);
+    }
+
+    free(times);
+    free(all_times);
+}
+
+/**
+ * The rotor and the clock offset its slots are timed against.
+ */
+struct rotor_state {
+    struct dccs_rotor rotor;
+    int64_t clock_offset;
+};
+
+int rotor_check(struct dccs_parameters *params) {
+    if (params->pacing != PACING_SLOT)
+        params->slot_us = DEFAULT_ROTOR_SLOT_US;
+    return 0;
+}
+
+int rotor_tool_init(struct dccs_transport *transport, struct dccs_parameters *params, void *state) {
+    struct rotor_state *rs = state;
+
+    if (rotor_init(&rs->rotor, transport, params) != 0)
+        return -1;
+    rs->clock_offset = sync_clock_offset(transport->size, transport->rank);
+    return 0;
+}
+
+int rotor_tool_run(struct dccs_transport *transport, struct dccs_parameters *params, void *state) {
+    struct rotor_state *rs = state;
+    uint64_t epoch = wait_for_epoch(transport->rank, rs->clock_offset);
+
+    if (rotor_run(&rs->rotor, params, (uint64_t)((int64_t)epoch - rs->clock_offset), params->warmup_count + params->count) != 0)
+        return -1;
+    report_run(&rs->rotor, params, params->warmup_count);
+    return rotor_verify(&rs->rotor, params) != 0 ? 1 : 0;
+}
+
+void rotor_tool_finish(struct dccs_transport *transport, struct dccs_parameters *params, void *state) {
+    struct rotor_state *rs = state;
+
+    (void)transport;
+    (void)params;
+    rotor_destroy(&rs->rotor);
+}
+
+const struct dccs_transport_tool rotor_tool = {
+    .name = "rotor",
+    .check = rotor_check,
+    .init = rotor_tool_init,
+    .run = rotor_tool_run,
+    .finish = rotor_tool_finish,
+};
+
+int main(int argc, char *argv[]) {
+    struct rotor_state state;
+
+    return transport_tool_main(argc, argv, &rotor_tool, &state);
+}